@@ -0,0 +1,126 @@
+#include "celero/Celero.h"
+
+#include "fmt/format.h"
+#include "reader.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+// This benchmark measures the I/O methods of FileReader using files of different sizes. Each file is
+// read while it is in the page cache (warm) and after its pages have been dropped from the page cache
+// using POSIX_FADV_DONTNEED (cold). The thresholds in io_strategy.hpp are picked using these results.
+// The 1GB and 2GB files are on both sides of DIRECT_THRESHOLD. All generated files are removed when the
+// benchmark exits.
+
+constexpr int number_of_samples = 10;
+constexpr int number_of_operations = 1;
+
+CELERO_MAIN
+
+namespace {
+    // Count lines so we only measure the cost of getting data into memory.
+    class CountLines {
+      public:
+        void process(const char *begin, const size_t len) { lines += std::count(begin, begin + len, '\n'); }
+        bool is_done() const { return false; }
+        size_t lines = 0;
+
+      protected:
+        void set_filename(const char *) {}
+        void finalize() {}
+    };
+
+    // A generated log file which is removed when the benchmark exits.
+    struct LogFile {
+        explicit LogFile(const size_t size) : fname(fmt::format("io_bench_{}.log", size)) {
+            FILE *fp = fopen(fname.data(), "wb");
+            if (fp == nullptr) return;
+            size_t nbytes = 0;
+            for (size_t idx = 0; nbytes < size; ++idx) {
+                const std::string line =
+                    fmt::format("{} INFO [worker-{}] Finished processing job {} in {} ms\n", idx, idx % 16,
+                                idx * 7, idx % 1000);
+                nbytes += fwrite(line.data(), 1, std::min(line.size(), size - nbytes), fp);
+            }
+            fclose(fp);
+        }
+
+        LogFile(const LogFile &) = delete;
+        LogFile &operator=(const LogFile &) = delete;
+
+        ~LogFile() { remove(fname.data()); }
+
+        std::string fname;
+    };
+
+    const LogFile file_4k(1 << 12);
+    const LogFile file_64k(1 << 16);
+    const LogFile file_1m(1 << 20);
+    const LogFile file_16m(1 << 24);
+    const LogFile file_256m(1 << 28);
+    const LogFile file_1g(size_t(1) << 30);
+    const LogFile file_2g(size_t(1) << 31);
+
+    void drop_cache(const std::string &fname) {
+        int fd = ::open(fname.data(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+
+    // Use -1 to select the I/O method using select_io_strategy.
+    void run(const std::string &fname, const int method, const size_t buffer_size, const bool cold) {
+        if (cold) drop_cache(fname);
+        fastgrep::FileReader<CountLines> reader;
+        reader.set_buffer_size(buffer_size);
+        if (method >= 0) reader.set_io_method(static_cast<fastgrep::IOMethod>(method));
+        reader(fname.data());
+        celero::DoNotOptimizeAway(reader.lines);
+    }
+
+    constexpr int READ = static_cast<int>(fastgrep::IOMethod::READ);
+    constexpr int READ_AHEAD = static_cast<int>(fastgrep::IOMethod::READ_AHEAD);
+    constexpr int MMAP = static_cast<int>(fastgrep::IOMethod::MMAP);
+    constexpr int DIRECT = static_cast<int>(fastgrep::IOMethod::DIRECT);
+    constexpr int AUTO = -1;
+} // namespace
+
+// All I/O methods of a file size and a page cache state.
+#define IO_BENCHMARKS(group, fname, cold)                                      \
+    BASELINE(group, read_64k, number_of_samples, number_of_operations) {       \
+        run(fname, READ, 1 << 16, cold);                                       \
+    }                                                                          \
+    BENCHMARK(group, read_1m, number_of_samples, number_of_operations) {       \
+        run(fname, READ, 1 << 20, cold);                                       \
+    }                                                                          \
+    BENCHMARK(group, read_ahead_1m, number_of_samples, number_of_operations) { \
+        run(fname, READ_AHEAD, 1 << 20, cold);                                 \
+    }                                                                          \
+    BENCHMARK(group, mmap, number_of_samples, number_of_operations) {          \
+        run(fname, MMAP, 1 << 16, cold);                                       \
+    }                                                                          \
+    BENCHMARK(group, direct_4m, number_of_samples, number_of_operations) {     \
+        run(fname, DIRECT, 1 << 22, cold);                                     \
+    }                                                                          \
+    BENCHMARK(group, adaptive, number_of_samples, number_of_operations) {      \
+        run(fname, AUTO, 1 << 16, cold);                                       \
+    }
+
+IO_BENCHMARKS(warm_4k, file_4k.fname, false)
+IO_BENCHMARKS(warm_64k, file_64k.fname, false)
+IO_BENCHMARKS(warm_1m, file_1m.fname, false)
+IO_BENCHMARKS(warm_16m, file_16m.fname, false)
+IO_BENCHMARKS(warm_256m, file_256m.fname, false)
+IO_BENCHMARKS(warm_1g, file_1g.fname, false)
+IO_BENCHMARKS(warm_2g, file_2g.fname, false)
+
+IO_BENCHMARKS(cold_4k, file_4k.fname, true)
+IO_BENCHMARKS(cold_64k, file_64k.fname, true)
+IO_BENCHMARKS(cold_1m, file_1m.fname, true)
+IO_BENCHMARKS(cold_16m, file_16m.fname, true)
+IO_BENCHMARKS(cold_256m, file_256m.fname, true)
+IO_BENCHMARKS(cold_1g, file_1g.fname, true)
+IO_BENCHMARKS(cold_2g, file_2g.fname, true)
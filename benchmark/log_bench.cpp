@@ -62,3 +62,13 @@ BENCHMARK(logdata, fgrep_second, log_search_samples, number_of_operations) {
 // BENCHMARK(logdata, fastgrep, log_search_samples, number_of_operations) {
 //     run_all_tests(logfile, "../commands/fastgrep", log_patterns);
 // }
+
+// Regular expressions which have a required literal are prefiltered using memmem so they should be as
+// fast as the exact match mode.
+BASELINE(prefilter, exact_match, log_search_samples, number_of_operations) {
+    run_a_test(logfile, "../commands/fgrep --exact-match", "p4pqmewebsync");
+}
+
+BENCHMARK(prefilter, regex, log_search_samples, number_of_operations) {
+    run_a_test(logfile, "../commands/fgrep", "p4pqmewebsync.*finished in (\\d)*");
+}
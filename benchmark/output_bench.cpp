@@ -0,0 +1,77 @@
+#include "celero/Celero.h"
+
+#include "fmt/format.h"
+#include "output.hpp"
+#include "params.hpp"
+#include "scan_policy.hpp"
+#include "scanners.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+constexpr int number_of_samples = 10;
+constexpr int number_of_operations = 1;
+
+CELERO_MAIN
+
+namespace {
+    std::string generate_data() {
+        std::string data;
+        for (size_t idx = 0; idx < 1000000; ++idx) {
+            data.append(fmt::format("{} INFO [worker-{}] Finished processing job {} in {} ms\n", idx, idx % 16,
+                                    idx * 7, idx % 1000));
+        }
+        return data;
+    }
+
+    const std::string data = generate_data();
+
+    // Grep the test data and redirect the STDOUT to /dev/null so we only measure the cost of formatting and
+    // writing search results.
+    template <typename Scanner, typename Console> void grep(const std::string &pattern, const bool linenum) {
+        constexpr size_t BUFFER_SIZE = 1 << 16;
+        fastgrep::Params params;
+        params.info = linenum * fastgrep::LINENUM;
+        fflush(stdout);
+        int stdout_fd = dup(STDOUT_FILENO);
+        int null_fd = ::open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        {
+            fastgrep::ScanPolicy<Scanner, Console> grep(pattern, params);
+            for (size_t pos = 0; pos < data.size(); pos += BUFFER_SIZE) {
+                grep.process(data.data() + pos, std::min(BUFFER_SIZE, data.size() - pos));
+            }
+        }
+        fflush(stdout);
+        dup2(stdout_fd, STDOUT_FILENO);
+        ::close(null_fd);
+        ::close(stdout_fd);
+    }
+} // namespace
+
+// All lines match the given pattern.
+BASELINE(all_lines, fmt, number_of_samples, number_of_operations) {
+    grep<fastgrep::ExactScanner, fastgrep::FMTPolicy>("Finished", false);
+}
+
+BENCHMARK(all_lines, writev, number_of_samples, number_of_operations) {
+    grep<fastgrep::ExactScanner, fastgrep::WritevPolicy>("Finished", false);
+}
+
+BASELINE(all_lines_linenum, fmt, number_of_samples, number_of_operations) {
+    grep<fastgrep::ExactScanner, fastgrep::FMTPolicy>("Finished", true);
+}
+
+BENCHMARK(all_lines_linenum, writev, number_of_samples, number_of_operations) {
+    grep<fastgrep::ExactScanner, fastgrep::WritevPolicy>("Finished", true);
+}
+
+// About 12% of lines match the given pattern.
+BASELINE(regex, fmt, number_of_samples, number_of_operations) {
+    grep<fastgrep::hyperscan::Scanner, fastgrep::FMTPolicy>("worker-(3|7)\\]", true);
+}
+
+BENCHMARK(regex, writev, number_of_samples, number_of_operations) {
+    grep<fastgrep::hyperscan::Scanner, fastgrep::WritevPolicy>("worker-(3|7)\\]", true);
+}
@@ -1,6 +1,12 @@
+#include "chunk_reader.hpp"
 #include "clara.hpp"
+#include "count_policy.hpp"
 #include "fmt/format.h"
 #include "grep.hpp"
+#include "field_filter.hpp"
+#include "header_filter.hpp"
+#include "message_pipeline.hpp"
+#include "inverse_policy.hpp"
 #include "ioutils/reader.hpp"
 #include "ioutils/regex_store_policies.hpp"
 #include "ioutils/search.hpp"
@@ -8,15 +14,28 @@
 #include "ioutils/simple_store_policy.hpp"
 #include "ioutils/stream.hpp"
 #include "params.hpp"
+#include "reader.hpp"
 #include "utils/matchers.hpp"
+#include "scheduler.hpp"
+#include "search_policy.hpp"
+#include "sidecar.hpp"
+#include "timestamp.hpp"
+#include "uring_reader.hpp"
 #include "utils/regex_matchers.hpp"
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <fstream>
+#include <limits>
 #include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 /**
- * The grep execution process has two steps:
- * 1. Expand the search paths and get the list of search files.
+ * The grep execution process has two steps which are run concurrently:
+ * 1. Expand the search paths and push found files to a queue.
  * 2. Search for given pattern using file contents and display the search results.
  */
 namespace {
@@ -26,17 +45,46 @@ namespace {
     }
 
     struct InputParams {
-        std::string pattern;            // Grep pattern
-        std::string path_pattern;       // Search path pattern
+        std::string pattern;               // Grep pattern. Multiple patterns are separated by EOL.
+        std::vector<std::string> patterns; // Search patterns given by -e and -f options.
+        std::string pattern_file;          // A file which has one search pattern per line.
+        std::string path_pattern;          // Search path pattern
         std::vector<std::string> paths; // Input files and folders
         fastgrep::Params parameters;    // Grep parameters
+        size_t nthreads = 1;            // The number of search threads
+        std::string io_method = "auto"; // The I/O method: auto, read, readahead, mmap, or direct.
+        size_t buffer_size = fastgrep::io::DEFAULT_BUFFER_SIZE; // The number of bytes per read call.
+        bool build_index = false;       // Build sidecar indexes instead of searching.
+        bool use_index = false;         // Skip blocks that cannot match using sidecar indexes.
+        bool use_time_range = false;    // Only search the lines in [begin_time, end_time].
+        int64_t begin_time = std::numeric_limits<int64_t>::min();
+        int64_t end_time = std::numeric_limits<int64_t>::max();
+        fastgrep::HeaderConstraints header; // Only search the messages whose headers are accepted.
+        fastgrep::FieldConstraints fields;  // Only search the lines whose JSON fields are accepted.
         void print() const {
             fmt::print("Pattern: {}\n", pattern);
             fmt::print("Path pattern: {}\n", pattern);
+            fmt::print("Number of threads: {}\n", nthreads);
+            fmt::print("I/O method: {}\n", io_method);
+            fmt::print("Buffer size: {}\n", buffer_size);
+            fmt::print("Use index: {}\n", use_index);
+            if (use_time_range) fmt::print("Time range: [{}, {}]\n", begin_time, end_time);
+            fmt::print("Header constraints: {}\n", !header.empty());
+            fmt::print("Field constraints: {}\n", !fields.empty());
             parameters.print();
         }
     };
 
+    // Read search patterns from a file. Each line is a pattern and empty lines are ignored.
+    void read_patterns(const std::string &fname, std::vector<std::string> &patterns) {
+        std::ifstream input(fname);
+        if (!input) throw std::runtime_error("Cannot open the pattern file: " + fname);
+        std::string line;
+        while (std::getline(input, line)) {
+            if (!line.empty()) patterns.emplace_back(std::move(line));
+        }
+    }
+
     // Use clara to parse input argument.
     InputParams parse_input_arguments(int argc, char *argv[]) {
         InputParams params;
@@ -55,8 +103,18 @@ namespace {
         bool color = false;   // Display color text.
         bool verbose = false; // Display verbose information.
 
+        bool quite = false;              // Stop at the first match and do not print anything.
+        bool files_with_matches = false; // Only print the names of files which have matched lines.
+        bool count = false;              // Only print the number of matched lines of each file.
+        bool show_pattern = false;       // Print the pattern that matches each line.
+        std::string cache_dir;           // Cache compiled hyperscan databases in this folder.
+        size_t context = 0;              // The number of context lines before and after each match.
+        std::string begin_time, end_time; // The time window of sorted log files.
+        std::vector<std::string> nodes;   // Accepted node names of message headers.
+        std::vector<std::string> pools;   // Accepted pool names of message headers.
+        std::vector<std::string> fields;  // KEY=VALUE constraints of JSON payloads.
+
         // TODO: Support Unicode
-        bool quite = false; // Search a file until a match has been found.
         bool utf8 = false;  // Support UTF8.
         bool utf16 = false; // Support UTF16.
         bool utf32 = false; // Support UTF32.
@@ -68,18 +126,66 @@ namespace {
             clara::Opt(ignore_case)["-i"]["--ignore-case"](
                 "Perform case insensitive matching. This is off by default.") |
             clara::Opt(recursive)["-r"]["-R"]["--recursive"]("Recursively search subdirectories listed.") |
-            clara::Opt(use_memmap)["--mmap"]("Use mmap to read the file content instead of read. This "
-                                             "approach does not work well for big files.") |
+            clara::Opt(use_memmap)["--mmap"]("Always use mmap to read the file content. This is the same "
+                                             "as --io mmap.") |
+            clara::Opt(params.io_method, "method")["--io"](
+                "The I/O method: auto, read, readahead, mmap, or direct. The auto method selects one for "
+                "each file using its size, its file system, and the number of its pages in the page "
+                "cache. The readahead method reads the next blocks in a separate thread.") |
+            clara::Opt(params.buffer_size, "bytes")["--buffer-size"](
+                "The number of bytes requested by each read call. Big files use at least 1MB.") |
             clara::Opt(color)["-c"]["--color"]("Print out color text. This option is off by default.") |
             clara::Opt(linenum)["-n"]["--linenum"]("Display line number. This option is off by default.") |
             clara::Opt(quite)["-q"]["--quite"](
-                "Search a file until a match has been found. This option is off by default.") |
+                "Do not print anything and exit with zero status as soon as a match has been found. This "
+                "option is off by default.") |
+            clara::Opt(files_with_matches)["-l"]["--files-with-matches"](
+                "Only print the names of files which have matched lines. Each file is searched until the "
+                "first match has been found.") |
+            clara::Opt(params.parameters.max_count, "num")["-m"]["--max-count"](
+                "Stop searching a file after num matched lines.") |
+            clara::Opt(count)["--count"]("Only print the number of matched lines of each file.") |
+            clara::Opt(params.parameters.after_context, "num")["-A"]["--after-context"](
+                "Print num lines of trailing context after matched lines.") |
+            clara::Opt(params.parameters.before_context, "num")["-B"]["--before-context"](
+                "Print num lines of leading context before matched lines.") |
+            clara::Opt(context, "num")["-C"]["--context"](
+                "Print num lines of context around matched lines.") |
             clara::Opt(stdin)["-s"]["--stdin"]("Read data from the STDIN.") |
             clara::Opt(utf8)["--utf8"]("Support UTF8 (WIP).") |
             clara::Opt(utf16)["--utf16"]("Support UTF16 (WIP).") |
             clara::Opt(utf32)["--utf32"]("Support UTF32 (WIP).") |
-            clara::Opt(params.pattern, "pattern")["-e"]["-E"]["--pattern"]["--regexp"]("Search pattern.") |
+            clara::Opt(params.patterns, "pattern")["-e"]["-E"]["--pattern"]["--regexp"](
+                "Search pattern. This option can be used many times to search for many patterns.") |
+            clara::Opt(params.pattern_file, "file")["-f"]["--file"](
+                "Read search patterns from a file, one per line. All patterns are searched in one pass.") |
+            clara::Opt(show_pattern)["--show-pattern"]("Print the pattern that matches each line.") |
+            clara::Opt(cache_dir, "dir")["--cache-dir"](
+                "Cache compiled search patterns in this folder. The default value is taken from the "
+                "FASTGREP_CACHE_DIR environment variable and the cache is disabled if it is empty.") |
             clara::Opt(params.path_pattern, "path_pattern")["-p"]["--path-regex"]("Path regex.") |
+            clara::Opt(params.nthreads, "threads")["-j"]["--threads"](
+                "The number of search threads. Use 0 to search with all available cores.") |
+            clara::Opt(params.build_index)["--build-index"](
+                "Build a sidecar index for each file, i.e foo.log.fgidx for foo.log, then exit. Indexes "
+                "are meant for immutable files such as rotated logs.") |
+            clara::Opt(params.use_index)["--use-index"](
+                "Skip the blocks that cannot match using sidecar indexes. Files whose indexes are missing "
+                "or out of date are searched as usual.") |
+            clara::Opt(begin_time, "time")["--begin"](
+                "Only search the lines at or after the given time in 'mm-dd-yyyy hh:mm:ss' format. Files "
+                "must be sorted by time so the time window is found using a binary search.") |
+            clara::Opt(end_time, "time")["--end"](
+                "Only search the lines at or before the given time in 'mm-dd-yyyy hh:mm:ss' format.") |
+            clara::Opt(nodes, "name")["--node"](
+                "Only search the messages whose headers have the given node name. A name which ends with "
+                "'*' is a prefix. This option can be used many times to accept many nodes.") |
+            clara::Opt(pools, "name")["--pool"](
+                "Only search the messages whose headers have the given pool name. A name which ends with "
+                "'*' is a prefix. This option can be used many times to accept many pools.") |
+            clara::Opt(fields, "key=value")["--field"](
+                "Only search the lines whose JSON objects have the given value of a top-level key, e.g "
+                "LEVEL=error. Values of the same key are alternatives and all keys must be matched.") |
 
             // Required arguments.
             clara::Arg(params.paths, "paths")("Search paths");
@@ -106,117 +212,384 @@ namespace {
                                  linenum * fastgrep::LINENUM | utf8 * fastgrep::UTF8 |
                                  use_memmap * fastgrep::USE_MEMMAP | exact_match * fastgrep::EXACT_MATCH |
                                  inverse_match * fastgrep::INVERSE_MATCH | stdin * fastgrep::STDIN |
-                                 recursive * fastgrep::RECURSIVE;
+                                 recursive * fastgrep::RECURSIVE | quite * fastgrep::QUITE |
+                                 files_with_matches * fastgrep::FILES_WITH_MATCHES |
+                                 count * fastgrep::COUNT | show_pattern * fastgrep::SHOW_PATTERN;
+
+        if (use_memmap) params.io_method = "mmap";
+        const std::vector<std::string> io_methods = {"auto", "read", "readahead", "mmap", "direct"};
+        if (std::find(io_methods.begin(), io_methods.end(), params.io_method) == io_methods.end()) {
+            throw std::runtime_error("Invalid I/O method: " + params.io_method);
+        }
+
+        if (params.nthreads == 0) { params.nthreads = std::max(1u, std::thread::hardware_concurrency()); }
+
+        // We will stop at the first match so there is no need to search files in parallel.
+        if (quite) params.nthreads = 1;
+
+        if (!params.pattern_file.empty()) { read_patterns(params.pattern_file, params.patterns); }
+        if (!cache_dir.empty()) { fastgrep::hyperscan::cache_directory() = cache_dir; }
+
+        // -A and -B take precedence over -C.
+        if (params.parameters.after_context == 0) params.parameters.after_context = context;
+        if (params.parameters.before_context == 0) params.parameters.before_context = context;
+
+        if (!begin_time.empty()) params.begin_time = fastgrep::timestamp::parse(begin_time);
+        if (!end_time.empty()) params.end_time = fastgrep::timestamp::parse(end_time);
+        params.use_time_range = !begin_time.empty() || !end_time.empty();
+
+        // STDIN cannot be seeked so the timestamp of each message is checked instead.
+        if (params.use_time_range && stdin) {
+            params.header.set_time_range(params.begin_time, params.end_time);
+            params.use_time_range = false;
+        }
+        for (auto const &name : nodes) params.header.add_node(name);
+        for (auto const &name : pools) params.header.add_pool(name);
+        for (auto const &item : fields) params.fields.add(item);
+
+        // Lines before the time window or lines of rejected messages are not given to policies so their
+        // numbers are unknown.
+        if ((params.use_time_range || !params.header.empty() || !params.fields.empty()) && linenum) {
+            throw std::runtime_error(
+                "Line numbers cannot be displayed when searching a time window or filtering messages.");
+        }
+
+        // Building indexes does not need any pattern.
+        if (params.build_index) return params;
 
         // If users do not specify the search pattern then the first elements of paths is the search
         // pattern.
-        if (params.pattern.empty()) {
+        if (params.patterns.empty()) {
             if (!stdin && params.paths.size() < 2) {
                 throw std::runtime_error(
                     "Invalid syntax. The search pattern and search paths are required.");
             }
-            params.pattern = params.paths.front();
+            params.patterns.push_back(params.paths.front());
             params.paths.erase(params.paths.begin());
         }
 
+        for (auto const &patt : params.patterns) {
+            if (!params.pattern.empty()) params.pattern.push_back(fastgrep::EOL);
+            params.pattern.append(patt);
+        }
+
         if (verbose) params.print();
 
         return params;
     }
 } // namespace
 
-// TODO: Find all files in the given paths.
-template <typename T> void fgrep(const InputParams &params) {
-    // Find all files that need to search.
+// Parallel searches use StringPolicy to collect search results of each task.
+template <typename Console> using is_parallel = std::is_same<Console, fastgrep::StringPolicy>;
+
+// Return the literals that a line must have to match one of the search patterns or an empty list if
+// sidecar indexes cannot be used to skip any block. Policies that print non-matching lines do not use
+// sidecar indexes.
+fastgrep::literals::Literals index_literals(const InputParams &params) {
+    using fastgrep::literals::Literals;
+    const int mode = params.parameters.regex_mode;
+    if (mode & HS_FLAG_CASELESS) return Literals();
+    Literals results;
+    const bool is_literal = params.parameters.exact_match();
+    for (auto const &patt : params.patterns) {
+        const Literals items =
+            is_literal ? Literals{patt} : fastgrep::literals::required_literals(patt, mode);
+        if (items.empty()) return Literals();
+        results.insert(results.end(), items.begin(), items.end());
+    }
+    return results;
+}
+
+// Set the I/O method and the read size of a reader.
+template <typename T> void setup_reader(T &grep, const InputParams &params) {
+    grep.set_buffer_size(params.buffer_size);
+    if (params.io_method == "read") {
+        grep.set_io_method(fastgrep::IOMethod::READ);
+    } else if (params.io_method == "readahead") {
+        grep.set_io_method(fastgrep::IOMethod::READ_AHEAD);
+    } else if (params.io_method == "mmap") {
+        grep.set_io_method(fastgrep::IOMethod::MMAP);
+    } else if (params.io_method == "direct") {
+        grep.set_io_method(fastgrep::IOMethod::DIRECT);
+    }
+    if (params.use_index) grep.set_index_query(fastgrep::sidecar::Query(index_literals(params)));
+    if (params.use_time_range) grep.set_time_range(params.begin_time, params.end_time);
+    if (!params.header.empty()) grep.set_header_constraints(params.header);
+    if (!params.fields.empty()) grep.set_field_constraints(params.fields);
+}
+
+// Traverse the search paths and push all found files to the queue. Return the number of found files.
+template <typename Policy> size_t find_files(const InputParams &params, fastgrep::PathQueue &queue) {
     ioutils::search::Params find_params;
     find_params.flags |= ioutils::search::IGNORE_SYMLINK | ioutils::search::IGNORE_DIR;
     find_params.regex = params.path_pattern;
+    using Search = typename ioutils::FileSearch<fastgrep::QueueStorePolicy<Policy>>;
+    Search search(find_params);
+    search.set_queue(&queue);
+    const size_t nfiles = fastgrep::traverse(search, params.paths);
+    queue.close();
+    return nfiles;
+}
+
+// Search for the given pattern in all files using one thread.
+template <typename T>
+size_t grep_files(const InputParams &params, fastgrep::PathQueue &queue, fastgrep::OrderedOutput &,
+                  std::false_type) {
+    T grep(params.pattern, params.parameters);
+    setup_reader(grep, params);
+    auto next = [&queue](fastgrep::SearchTask &task) { return queue.pop(task); };
+    auto stop = [&params, &queue, &grep]() {
+        if (!params.parameters.quite() || (grep.number_of_matches() == 0)) return false;
 
-    if (find_params.regex.empty()) {
-        using Policy = ioutils::StorePolicy;
-        using Search = typename ioutils::FileSearch<Policy>;
-        Search search(find_params);
-        search.traverse(params.paths);
+        // Tell the producer that we do not need more files.
+        queue.close();
+        return true;
+    };
+    grep.template run<fastgrep::SearchTask>(next, [](const fastgrep::SearchTask &) {}, stop);
+    return grep.number_of_matches();
+}
+
+// Search for the given pattern using a pool of threads. Each thread has its own reader and the search
+// results of each file are written to the STDOUT in the order files are found.
+template <typename T>
+size_t grep_files(const InputParams &params, fastgrep::PathQueue &queue, fastgrep::OrderedOutput &output,
+                  std::true_type) {
+    fastgrep::Scheduler<fastgrep::SearchTask> scheduler(params.nthreads, queue);
+    std::atomic<size_t> matches(0);
+    scheduler.start([&params, &scheduler, &output, &matches](const size_t worker) {
         T grep(params.pattern, params.parameters);
-        auto const &all_paths = search.get_paths();
-        for (auto const &afile : all_paths) {
-            grep(afile.data());
-        }
-    } else {
+        setup_reader(grep, params);
+        auto next = [&scheduler, worker](fastgrep::SearchTask &task) {
+            return scheduler.next(worker, task);
+        };
+        auto done = [&grep, &output](const fastgrep::SearchTask &task) {
+            auto &console = grep.get_console();
+            output.set(task.index, std::move(console.buffer));
+            console.buffer.clear();
+        };
+        grep.template run<fastgrep::SearchTask>(next, done);
+        matches += grep.number_of_matches();
+    });
+    output.write();
+    scheduler.join();
+    return matches;
+}
+
+// Files are searched while we are traversing the search paths so we can display the search results as
+// soon as possible and we only need to keep a small number of paths in memory.
+template <typename T, typename Console> size_t fgrep(const InputParams &params) {
+    constexpr size_t QUEUE_SIZE = 1 << 12;
+    fastgrep::PathQueue queue(QUEUE_SIZE);
+    fastgrep::OrderedOutput output;
+    std::thread producer([&params, &queue, &output]() {
         using Matcher = utils::hyperscan::RegexMatcher;
-        using Policy = ioutils::RegexStorePolicy<Matcher>;
-        using Search = typename ioutils::FileSearch<Policy>;
-        Search search(find_params);
-        search.traverse(params.paths);
-        T grep(params.pattern, params.parameters);
-        auto const &all_paths = search.get_paths();
-        for (auto const &afile : all_paths) {
-            grep(afile.data());
+        const size_t nfiles = params.path_pattern.empty()
+                                  ? find_files<ioutils::StorePolicy>(params, queue)
+                                  : find_files<ioutils::RegexStorePolicy<Matcher>>(params, queue);
+        output.close(nfiles);
+    });
+    const size_t matches = grep_files<T>(params, queue, output, is_parallel<Console>());
+    producer.join();
+    return matches;
+}
+
+// Build the sidecar index of all found files. A file is skipped if it is changed while we are indexing
+// it. Existing indexes are never searched or indexed.
+size_t build_indexes(const InputParams &params) {
+    constexpr size_t QUEUE_SIZE = 1 << 12;
+    fastgrep::PathQueue queue(QUEUE_SIZE);
+    std::thread producer([&params, &queue]() {
+        using Matcher = utils::hyperscan::RegexMatcher;
+        if (params.path_pattern.empty()) {
+            find_files<ioutils::StorePolicy>(params, queue);
+        } else {
+            find_files<ioutils::RegexStorePolicy<Matcher>>(params, queue);
+        }
+    });
+
+    fastgrep::FileReader<fastgrep::sidecar::Builder> builder;
+    fastgrep::SearchTask task;
+    const std::string suffix(fastgrep::sidecar::SUFFIX);
+    size_t nfiles = 0;
+    while (queue.pop(task)) {
+        const std::string &path = task.path;
+        const bool is_index = (path.size() >= suffix.size()) &&
+                              (path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0);
+        if (is_index) continue;
+        struct stat before, after;
+        if ((stat(path.data(), &before) < 0) || !S_ISREG(before.st_mode)) continue;
+        builder(path.data());
+        if ((stat(path.data(), &after) < 0) || (after.st_size != before.st_size) ||
+            (after.st_mtim.tv_sec != before.st_mtim.tv_sec) ||
+            (after.st_mtim.tv_nsec != before.st_mtim.tv_nsec)) {
+            fmt::print(stderr, "Skip {} because it is changed while being indexed.\n", path);
+            continue;
         }
+        builder.save(fastgrep::sidecar::path(path), before);
+        if (params.parameters.verbose()) fmt::print("Indexed {}: {} blocks\n", path, builder.size());
+        ++nfiles;
     }
-    // Grep all found files.
+    producer.join();
+    return nfiles;
 }
 
 // grep for desired lines from STDIN
-template <typename T> void fgrep_stdin(const InputParams &params) {
+template <typename T> size_t fgrep_stdin(const InputParams &params) {
     T grep(params.pattern, params.parameters);
+    setup_reader(grep, params);
     grep(STDIN_FILENO);
+    return grep.number_of_matches();
 }
 
-int main(int argc, char *argv[]) {
-    auto params = parse_input_arguments(argc, argv);
-    constexpr int BUFFER_SIZE = 1 << 16;
+// Search a big file using many threads. Chunks must end at a message boundary if messages are filtered
+// by their headers.
+template <typename Policy> size_t grep_chunks(const InputParams &params, std::true_type) {
+    if (params.header.empty() && params.fields.empty()) {
+        fastgrep::ChunkReader<Policy> grep(params.pattern, params.parameters, params.nthreads);
+        return grep(params.paths.front().data());
+    }
+    using Worker = fastgrep::ChunkSearch<Policy>;
+    fastgrep::MessagePipeline<Worker> grep(params.nthreads, !params.header.empty());
+    auto setup = [&params](Worker &worker) { setup_reader(worker, params); };
+    auto sink = [](const std::string &data) {
+        if (!data.empty()) fwrite(data.data(), 1, data.size(), stdout);
+    };
+    const size_t matches =
+        grep(params.paths.front().data(), setup, sink, params.pattern, params.parameters);
+    fflush(stdout);
+    return matches;
+}
 
-    // Search for given pattern based on input parameters
+// The chunk search is only used with the parallel search so this overload should never be called.
+template <typename Policy> size_t grep_chunks(const InputParams &params, std::false_type) {
+    fastgrep::FileReader<Policy> grep(params.pattern, params.parameters);
+    setup_reader(grep, params);
+    grep(params.paths.front().data());
+    return grep.number_of_matches();
+}
+
+// Return true if users want to search a single big file using many threads. Early exit modes need to
+// read a file from the beginning so they are not supported.
+bool use_chunks(const InputParams &params) {
+    constexpr size_t BIG_FILE_SIZE = 1 << 26;
+    if ((params.nthreads < 2) || (params.paths.size() != 1) || !params.path_pattern.empty()) return false;
+    if (params.parameters.files_with_matches() || (params.parameters.max_count > 0)) return false;
+    if (params.parameters.count() || params.parameters.context()) return false;
+    if (params.use_index || params.use_time_range) return false;
+    struct stat buf;
+    if (stat(params.paths.front().data(), &buf) < 0) return false;
+    return S_ISREG(buf.st_mode) && (static_cast<size_t>(buf.st_size) > BIG_FILE_SIZE);
+}
+
+// Search for given pattern using the read based readers.
+template <typename Policy, typename Console> size_t fgrep_read(const InputParams &params) {
+    if (params.parameters.stdin()) {
+        return fgrep_stdin<fastgrep::StreamReader<Policy>>(params);
+    } else if (use_chunks(params)) {
+        return grep_chunks<Policy>(params, is_parallel<Console>());
+    } else {
+        return fgrep<fastgrep::UringReader<Policy>, Console>(params);
+    }
+}
+
+// Count matched lines without extracting them. CountPolicy takes care of the inverse match.
+template <typename Console> size_t count(const InputParams &params) {
     if (params.parameters.exact_match()) {
+        using Policy = fastgrep::CountPolicy<fastgrep::ExactScanner, Console>;
+        return fgrep_read<Policy, Console>(params);
+    } else {
+        using Policy = fastgrep::CountPolicy<fastgrep::hyperscan::Scanner, Console>;
+        return fgrep_read<Policy, Console>(params);
+    }
+}
+
+// Search for many patterns in one pass using a multi-pattern hyperscan database.
+template <typename Scanner, typename Console> size_t search_patterns(const InputParams &params) {
+    if (params.parameters.count()) {
+        using Policy = fastgrep::CountPolicy<Scanner, Console>;
+        return fgrep_read<Policy, Console>(params);
+    } else if (!params.parameters.inverse_match()) {
+        using Policy = fastgrep::ScanPolicy<Scanner, Console>;
+        return fgrep_read<Policy, Console>(params);
+    } else {
+        using Policy = fastgrep::InversePolicy<Scanner, Console>;
+        return fgrep_read<Policy, Console>(params);
+    }
+}
+
+// Context lines are only supported by StreamPolicy so scanners are used as line matchers.
+template <typename Scanner, typename Console> size_t search_context(const InputParams &params) {
+    if (!params.parameters.inverse_match()) {
+        using Policy = fastgrep::StreamPolicy<fastgrep::ScanMatcher<Scanner>, Console>;
+        return fgrep_read<Policy, Console>(params);
+    } else {
+        using Policy = fastgrep::StreamPolicy<fastgrep::ScanMatcherInv<Scanner>, Console>;
+        return fgrep_read<Policy, Console>(params);
+    }
+}
+
+template <typename Console> size_t search_context(const InputParams &params) {
+    if (params.patterns.size() > 1) {
+        if (params.parameters.exact_match()) {
+            return search_context<fastgrep::hyperscan::ExactMultiScanner, Console>(params);
+        }
+        return search_context<fastgrep::hyperscan::MultiScanner, Console>(params);
+    } else if (params.parameters.exact_match()) {
+        return search_context<fastgrep::ExactScanner, Console>(params);
+    } else {
+        return search_context<fastgrep::hyperscan::Scanner, Console>(params);
+    }
+}
+
+// Return the number of matched lines.
+template <typename Console> size_t search(const InputParams &params) {
+    // Search for given pattern based on input parameters
+    if (params.parameters.context() && !params.parameters.count()) {
+        return search_context<Console>(params);
+    } else if (params.patterns.size() > 1) {
+        if (params.parameters.exact_match()) {
+            return search_patterns<fastgrep::hyperscan::ExactMultiScanner, Console>(params);
+        }
+        return search_patterns<fastgrep::hyperscan::MultiScanner, Console>(params);
+    } else if (params.parameters.count()) {
+        return count<Console>(params);
+    } else if (params.parameters.exact_match()) {
         if (!params.parameters.inverse_match()) {
-            using Matcher = utils::ExactMatcher;
-            if (params.parameters.use_memmap()) {
-                using Policy = typename fastgrep::SimplePolicy<Matcher>;
-                using Reader = ioutils::MMapReader<Policy>;
-                fgrep<Reader>(params);
-            } else {
-                using Policy = fastgrep::StreamPolicy<Matcher>;
-                params.parameters.stdin() ? fgrep_stdin<ioutils::StreamReader<Policy, BUFFER_SIZE>>(params)
-                                          : fgrep<ioutils::FileReader<Policy, BUFFER_SIZE>>(params);
-            }
+            using Policy = fastgrep::ScanPolicy<fastgrep::ExactScanner, Console>;
+            return fgrep_read<Policy, Console>(params);
         } else {
-            using Matcher = utils::ExactMatcherInv;
-            if (params.parameters.use_memmap()) {
-                using Policy = typename fastgrep::SimplePolicy<Matcher>;
-                using Reader = ioutils::MMapReader<Policy>;
-                fgrep<Reader>(params);
-            } else {
-                using Policy = fastgrep::StreamPolicy<Matcher>;
-                params.parameters.stdin() ? fgrep_stdin<ioutils::StreamReader<Policy, BUFFER_SIZE>>(params)
-                                          : fgrep<ioutils::FileReader<Policy, BUFFER_SIZE>>(params);
-            }
+            using Policy = fastgrep::InversePolicy<fastgrep::ExactScanner, Console>;
+            return fgrep_read<Policy, Console>(params);
         }
     } else {
         if (!params.parameters.inverse_match()) {
-            using Matcher = utils::hyperscan::RegexMatcher;
-            if (params.parameters.use_memmap()) {
-                using Policy = typename fastgrep::SimplePolicy<Matcher>;
-                using Reader = ioutils::MMapReader<Policy>;
-                fgrep<Reader>(params);
-            } else {
-                using Policy = typename fastgrep::StreamPolicy<Matcher>;
-                params.parameters.stdin() ? fgrep_stdin<ioutils::StreamReader<Policy, BUFFER_SIZE>>(params)
-                                          : fgrep<ioutils::FileReader<Policy, BUFFER_SIZE>>(params);
-            }
+            using Policy = typename fastgrep::ScanPolicy<fastgrep::hyperscan::Scanner, Console>;
+            return fgrep_read<Policy, Console>(params);
         } else {
-            using Matcher = utils::hyperscan::RegexMatcherInv;
-            if (params.parameters.use_memmap()) {
-                using Policy = typename fastgrep::SimplePolicy<Matcher>;
-                using Reader = ioutils::MMapReader<Policy>;
-                fgrep<Reader>(params);
-            } else {
-                using Policy = typename fastgrep::StreamPolicy<Matcher>;
-                params.parameters.stdin() ? fgrep_stdin<ioutils::StreamReader<Policy, BUFFER_SIZE>>(params)
-                                          : fgrep<ioutils::FileReader<Policy, BUFFER_SIZE>>(params);
-            }
+            using Policy = fastgrep::InversePolicy<fastgrep::hyperscan::Scanner, Console>;
+            return fgrep_read<Policy, Console>(params);
         }
     }
+}
+
+int main(int argc, char *argv[]) {
+    auto params = parse_input_arguments(argc, argv);
+    if (params.build_index) {
+        build_indexes(params);
+        return EXIT_SUCCESS;
+    }
+
+    // The parallel search writes search results to string buffers so they can be displayed in order. The
+    // single threaded search writes search results directly to the STDOUT using writev.
+    size_t matches = 0;
+    if ((params.nthreads > 1) && !params.parameters.stdin()) {
+        matches = search<fastgrep::StringPolicy>(params);
+    } else {
+        fflush(stdout);
+        matches = search<fastgrep::WritevPolicy>(params);
+    }
 
+    // The exit status tells users whether the pattern has been found in quite mode.
+    if (params.parameters.quite()) return (matches > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
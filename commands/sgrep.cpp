@@ -1,14 +1,21 @@
 #include "algorithms.hpp"
 #include "boost/program_options.hpp"
+#include "field_filter.hpp"
 #include "fmt/format.h"
+#include "header_filter.hpp"
+#include "lifecycle.hpp"
 #include "message_filter.hpp"
+#include "message_pipeline.hpp"
+#include "reader.hpp"
 #include "utils/matchers.hpp"
 #include "utils/matchers_avx2.hpp"
 #include "utils/regex_matchers.hpp"
 #include "utils/timestamp.hpp"
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <string>
+#include <thread>
 
 #include "header.hpp"
 
@@ -26,29 +33,131 @@ namespace {
         }
     }
 
-    template <typename Constraints> void filter(const scribe::MessageFilterParams &params) {
+    // Pass the lines found by fastgrep::FileReader to a message filter.
+    template <typename MessageFilter> class ForwardPolicy {
+      public:
+        explicit ForwardPolicy(MessageFilter &filter) : filter(filter) {}
+        void process(const char *begin, const size_t len) { filter.process(begin, len); }
+        bool is_done() const { return false; }
+
+      protected:
+        void set_filename(const char *) {}
+        void finalize() { filter.finalize(); }
+
+      private:
+        MessageFilter &filter;
+    };
+
+    // Collect the messages accepted by the header and field constraints of a pipeline worker.
+    class CollectPolicy {
+      public:
+        struct Console {
+            std::string buffer;
+        };
+
+        void process(const char *begin, const size_t len) { console.buffer.append(begin, len); }
+        bool is_done() const { return false; }
+        Console &get_console() { return console; }
+        size_t number_of_matches() const { return 0; }
+
+      protected:
+        void set_filename(const char *) {}
+        void finalize() {}
+
+      private:
+        Console console;
+    };
+
+    // Read and filter messages in place using a pool of threads. The accepted messages are given to the
+    // message filter in the file order by the calling thread because it writes the results itself. Files
+    // cannot be seeked so the time window must be checked by the header constraints.
+    template <typename Files, typename MessageFilter>
+    void filter_parallel(const Files &files, MessageFilter &filter,
+                         const fastgrep::HeaderConstraints &header,
+                         const fastgrep::FieldConstraints &fields, const size_t nthreads) {
+        using Worker = fastgrep::ChunkSearch<CollectPolicy>;
+        auto setup = [&header, &fields](Worker &worker) {
+            worker.set_header_constraints(header);
+            worker.set_field_constraints(fields);
+        };
+        auto sink = [&filter](const std::string &data) {
+            if (!data.empty()) filter.process(data.data(), data.size());
+        };
+        fastgrep::MessagePipeline<Worker> pipeline(nthreads);
+        for (auto const &afile : files) {
+            pipeline(afile.c_str(), setup, sink);
+            filter.finalize();
+        }
+    }
+
+    // Build the lifecycle of all messages in the given files and print a summary. The time window of
+    // sorted files is found using a binary search if users want to seek.
+    template <typename Files>
+    void track(const Files &files, const fastgrep::lifecycle::Options &options,
+               fastgrep::HeaderConstraints header, const fastgrep::FieldConstraints &fields,
+               const int64_t begin, const int64_t end, const bool seek, const size_t nthreads) {
+        using Tracker = fastgrep::LifecycleTracker;
+        Tracker tracker(options);
+        const bool has_window =
+            (begin != std::numeric_limits<int64_t>::min()) || (end != std::numeric_limits<int64_t>::max());
+        if (has_window && (!seek || (nthreads > 1))) header.set_time_range(begin, end);
+        if (nthreads > 1) {
+            filter_parallel(files, tracker, header, fields, nthreads);
+        } else {
+            fastgrep::FileReader<ForwardPolicy<Tracker>> reader(tracker);
+            if (has_window && seek) reader.set_time_range(begin, end);
+            reader.set_header_constraints(header);
+            reader.set_field_constraints(fields);
+            for (auto const &afile : files) { reader(afile.c_str()); }
+        }
+        tracker.print();
+    }
+
+    // Scribe logs are sorted by time so the time window of a file is found using a binary search and
+    // only its lines are read if users want to seek. Header and field constraints reject messages in the
+    // read buffer before they are given to the message filter. Files are read by a pipeline of threads if
+    // users want to use many threads.
+    template <typename Constraints>
+    void filter(const scribe::MessageFilterParams &params, const fastgrep::HeaderConstraints &header,
+                const fastgrep::FieldConstraints &fields, const bool seek, const size_t nthreads) {
         constexpr size_t BUFFER_SIZE = 1 << 16;
         Constraints cons(params);
         using MessageFilter = typename scribe::MessageFilter<Constraints>;
         MessageFilter filter(params);
+        if (nthreads > 1) {
+            fastgrep::HeaderConstraints constraints(header);
+            if (seek) constraints.set_time_range(params.begin, params.end);
+            filter_parallel(params.infiles, filter, constraints, fields, nthreads);
+            return;
+        }
+        if (seek || !header.empty() || !fields.empty()) {
+            fastgrep::FileReader<ForwardPolicy<MessageFilter>> reader(filter);
+            if (seek) reader.set_time_range(params.begin, params.end);
+            reader.set_header_constraints(header);
+            reader.set_field_constraints(fields);
+            for (auto afile : params.infiles) { reader(afile.c_str()); }
+            return;
+        }
         scribe::FileReader<BUFFER_SIZE, MessageFilter> reader;
         for (auto afile : params.infiles) { reader(afile.c_str(), filter); }
     }
 
-    template <typename T> void exec(const scribe::MessageFilterParams &params) {
+    template <typename T>
+    void exec(const scribe::MessageFilterParams &params, const fastgrep::HeaderConstraints &header,
+              const fastgrep::FieldConstraints &fields, const bool seek, const size_t nthreads) {
         const int case_number = ((!params.pattern.empty()) << 2) +
                                 ((params.begin != utils::MIN_TIME) << 1) +
                                 (params.end != utils::MAX_TIME);
         // fmt::print("case_number: {}\n", case_number);
         switch (case_number) {
         case 0:
-            filter<scribe::All>(params);
+            filter<scribe::All>(params, header, fields, false, nthreads);
             break;
         case 4:
-            filter<typename scribe::SimpleConstraints<T>>(params);
+            filter<typename scribe::SimpleConstraints<T>>(params, header, fields, false, nthreads);
             break;
         default:
-            filter<typename scribe::BasicConstraints<T>>(params);
+            filter<typename scribe::BasicConstraints<T>>(params, header, fields, seek, nthreads);
             break;
         }
     }
@@ -60,6 +169,9 @@ int main(int argc, char *argv[]) {
     std::string begin_time, end_time;
     scribe::MessageFilterParams params;
     std::vector<std::string> args;
+    std::vector<std::string> nodes, pools, fields;
+    size_t nthreads = 1;
+    fastgrep::lifecycle::Options lifecycle_options;
 
     // clang-format off
     desc.add_options()
@@ -70,6 +182,25 @@ int main(int argc, char *argv[]) {
 		("no-regex", "Do not use regex engine for pattern matching.")
 		("begin,b", po::value<std::string>(&begin_time), "Begin time in 'mm-dd-yyyy hh:mm:ss' format.")
 		("end,e", po::value<std::string>(&end_time), "End time in 'mm-dd-yyyy hh:mm:ss' format")
+		("no-seek", "Read whole files instead of binary searching the time window. "
+		 "Use it if log files are not sorted by time.")
+		("node", po::value<std::vector<std::string>>(&nodes),
+		 "Only search the messages of the given nodes. A name which ends with '*' is a prefix.")
+		("pool", po::value<std::vector<std::string>>(&pools),
+		 "Only search the messages of the given pools. A name which ends with '*' is a prefix.")
+		("field", po::value<std::vector<std::string>>(&fields),
+		 "Only search the messages whose JSON objects have the given KEY=VALUE top-level field.")
+		("threads,j", po::value<size_t>(&nthreads),
+		 "The number of threads used to read and filter messages. Use 0 to use all cores.")
+		("lifecycle", "Track the lifecycle of all messages instead of searching them. All arguments are "
+		 "log files, and the latency distribution and the stuck messages are reported.")
+		("id-key", po::value<std::string>(&lifecycle_options.id_key),
+		 "The JSON key of message ids used by --lifecycle. The default key is ID.")
+		("stuck-after", po::value<int64_t>(&lifecycle_options.stuck_after),
+		 "A published message is stuck if it does not have any control message after this number "
+		 "of seconds. The default value is 300.")
+		("max-stuck", po::value<size_t>(&lifecycle_options.max_stuck),
+		 "The maximum number of reported stuck messages. The default value is 20.")
         ("arguments,a", po::value<std::vector<std::string>>(&args), "Search pattern and files")
         ("output,o", po::value<std::string>(&params.outfile), "Output file");
     // clang-format on
@@ -92,6 +223,25 @@ int main(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    fastgrep::HeaderConstraints header;
+    for (auto const &name : nodes) header.add_node(name);
+    for (auto const &name : pools) header.add_pool(name);
+    fastgrep::FieldConstraints field_constraints;
+    for (auto const &item : fields) field_constraints.add(item);
+    const bool seek = (vm.count("no-seek") == 0);
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // All arguments are log files in the lifecycle mode.
+    if (vm.count("lifecycle")) {
+        if (args.empty()) throw std::runtime_error("You must provide log files!");
+        const int64_t begin = begin_time.empty() ? std::numeric_limits<int64_t>::min()
+                                                 : fastgrep::timestamp::parse(begin_time);
+        const int64_t end =
+            end_time.empty() ? std::numeric_limits<int64_t>::max() : fastgrep::timestamp::parse(end_time);
+        track(args, lifecycle_options, header, field_constraints, begin, end, seek, nthreads);
+        return EXIT_SUCCESS;
+    }
+
     // Process input parameters
     if (args.size() < 2) {
         throw std::runtime_error("You must provide both search pattern and files!");
@@ -108,9 +258,9 @@ int main(int argc, char *argv[]) {
 
     // Search for desired lines from given log files.
     if (vm.count("no-regex")) {
-        exec<utils::avx2::Contains>(params);
+        exec<utils::avx2::Contains>(params, header, field_constraints, seek, nthreads);
     } else {
-        exec<utils::hyperscan::RegexMatcher>(params);
+        exec<utils::hyperscan::RegexMatcher>(params, header, field_constraints, seek, nthreads);
     }
 
     return EXIT_SUCCESS;
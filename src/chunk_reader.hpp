@@ -0,0 +1,186 @@
+#pragma once
+
+#include "constants.hpp"
+#include "params.hpp"
+#include "queue.hpp"
+#include "scheduler.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace fastgrep {
+    // Policies might use 32 bit offsets internally so a big range of lines is passed to them in blocks of
+    // about RANGE_BLOCK_SIZE bytes. Blocks end at EOL so lines are never copied to the line buffer of a
+    // policy. We stop as soon as is_done returns true.
+    constexpr size_t RANGE_BLOCK_SIZE = 1 << 20;
+
+    template <typename Process, typename IsDone>
+    void for_each_block(const char *begin, const char *end, Process &&process, IsDone &&is_done) {
+        const char *ptr = begin;
+        while ((ptr < end) && !is_done()) {
+            const char *block_end = end;
+            if (static_cast<size_t>(end - ptr) > RANGE_BLOCK_SIZE) {
+                const char *next = ptr + RANGE_BLOCK_SIZE;
+                auto eol = static_cast<const char *>(memchr(next, EOL, end - next));
+                if (eol != nullptr) block_end = eol + 1;
+            }
+            process(ptr, block_end - ptr);
+            ptr = block_end;
+        }
+    }
+
+    // Search a range of lines using a policy. The range must start at the beginning of a line and the
+    // line number of the first line is given by the caller.
+    template <typename Policy> class RangeSearch : public Policy {
+      public:
+        template <typename Params>
+        RangeSearch(const std::string &patt, Params &&params)
+            : Policy(patt, std::forward<Params>(params)) {}
+
+        void operator()(const char *fname, const char *begin, const char *end, const size_t linenum) {
+            Policy::set_filename(fname);
+            this->lines = linenum;
+            auto process = [this](const char *block, const size_t len) { Policy::process(block, len); };
+            for_each_block(begin, end, process, [this]() { return Policy::is_done(); });
+            Policy::finalize();
+        }
+    };
+
+    // Search a big file using many threads. The file content is mapped into memory and it is split into
+    // chunks which end at EOL. Each chunk is searched by a worker and the search results are written to
+    // the STDOUT, or given to a sink, in the file order. Line numbers are computed using the number of
+    // lines in all previous chunks so they are the same as those of a single threaded search.
+    template <typename Policy> class ChunkReader {
+      public:
+        ChunkReader(const std::string &patt, const Params &params, const size_t threads,
+                    const size_t chunk = 1 << 26)
+            : pattern(patt), parameters(params), nthreads(std::max<size_t>(threads, 1)),
+              chunk_size(chunk) {}
+
+        // Return the number of matched lines.
+        size_t operator()(const char *datafile) {
+            const size_t matches = (*this)(datafile, [](const std::string &data) {
+                if (!data.empty()) fwrite(data.data(), 1, data.size(), stdout);
+            });
+            fflush(stdout);
+            return matches;
+        }
+
+        // The sink gets the output of each chunk in the file order.
+        template <typename Sink> size_t operator()(const char *datafile, Sink &&sink) {
+            int fd = ::open(datafile, O_RDONLY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open file: %s\n", datafile);
+                return 0;
+            }
+
+            struct stat buf;
+            if (fstat(fd, &buf) < 0 || buf.st_size == 0) {
+                ::close(fd);
+                return 0;
+            }
+
+            const size_t size = buf.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                fprintf(stderr, "Cannot map file: %s\n", datafile);
+                return 0;
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+
+            const char *data = static_cast<const char *>(mapped);
+            auto chunks = split(data, size);
+            auto linenums = first_lines(data, chunks);
+            const size_t matches = search(datafile, data, chunks, linenums, sink);
+            munmap(mapped, size);
+            return matches;
+        }
+
+      private:
+        std::string pattern;
+        Params parameters;
+        size_t nthreads;
+        size_t chunk_size;
+
+        using Chunk = std::pair<size_t, size_t>;
+
+        // Split the file content into chunks which end at EOL.
+        std::vector<Chunk> split(const char *data, const size_t size) const {
+            std::vector<Chunk> chunks;
+            size_t begin = 0;
+            while (begin < size) {
+                size_t end = std::min(begin + chunk_size, size);
+                if (end < size) {
+                    auto ptr = static_cast<const char *>(memchr(data + end, EOL, size - end));
+                    end = (ptr == nullptr) ? size : (ptr - data + 1);
+                }
+                chunks.emplace_back(begin, end);
+                begin = end;
+            }
+            return chunks;
+        }
+
+        // Compute the line number of the first line of each chunk. We only need to count lines if users
+        // want to display line numbers.
+        std::vector<size_t> first_lines(const char *data, const std::vector<Chunk> &chunks) const {
+            std::vector<size_t> linenums(chunks.size(), 1);
+            if (!parameters.linenum()) return linenums;
+
+            std::vector<size_t> counts(chunks.size(), 0);
+            std::vector<std::thread> threads;
+            for (size_t tid = 0; tid < nthreads; ++tid) {
+                threads.emplace_back([this, tid, data, &chunks, &counts]() {
+                    for (size_t idx = tid; idx < chunks.size(); idx += nthreads) {
+                        counts[idx] = simd::count(data + chunks[idx].first, data + chunks[idx].second, EOL);
+                    }
+                });
+            }
+            for (auto &athread : threads) athread.join();
+
+            for (size_t idx = 1; idx < chunks.size(); ++idx) {
+                linenums[idx] = linenums[idx - 1] + counts[idx - 1];
+            }
+            return linenums;
+        }
+
+        template <typename Sink>
+        size_t search(const char *datafile, const char *data, const std::vector<Chunk> &chunks,
+                      const std::vector<size_t> &linenums, Sink &&sink) {
+            BoundedQueue<size_t> tasks(chunks.size());
+            for (size_t idx = 0; idx < chunks.size(); ++idx) tasks.push(size_t(idx));
+            tasks.close();
+
+            OrderedOutput output;
+            output.close(chunks.size());
+            Scheduler<size_t> scheduler(std::min(nthreads, chunks.size()), tasks);
+            std::atomic<size_t> matches(0);
+            auto worker_fn = [this, datafile, data, &chunks, &linenums, &scheduler, &output,
+                              &matches](const size_t worker) {
+                RangeSearch<Policy> grep(pattern, parameters);
+                size_t task;
+                while (scheduler.next(worker, task)) {
+                    grep(datafile, data + chunks[task].first, data + chunks[task].second, linenums[task]);
+                    auto &console = grep.get_console();
+                    output.set(task, std::move(console.buffer));
+                    console.buffer.clear();
+                }
+                matches += grep.number_of_matches();
+            };
+            scheduler.start(worker_fn);
+            output.write(sink);
+            scheduler.join();
+            return matches;
+        }
+    };
+} // namespace fastgrep
@@ -2,4 +2,5 @@
 
 namespace fastgrep {
     static constexpr char EOL = '\n';
+    static constexpr char SEPARATOR[] = "--"; // The separator of context line groups.
 }
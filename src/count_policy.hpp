@@ -0,0 +1,144 @@
+#pragma once
+
+#include "constants.hpp"
+#include "fmt/format.h"
+#include "output.hpp"
+#include "scanners.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace fastgrep {
+    // CountPolicy only counts the number of matched lines of each file. It scans all complete lines of a
+    // buffer using a single scanner call, and a line is counted once no matter how many matches it has
+    // because the scan restarts at the beginning of the next line. Lines are neither copied nor formatted
+    // and the only output is a "filename:count" line which is printed when a file has been searched.
+    template <typename Scanner, typename Console = FMTPolicy> class CountPolicy {
+      public:
+        template <typename Params>
+        CountPolicy(const std::string &patt, Params &&params)
+            : scanner(patt, params.regex_mode), linebuf(), console(), color(params.color()),
+              inverse(params.inverse_match()), quite(params.quite()),
+              max_count(quite ? 1 : params.max_count) {}
+
+        void process(const char *begin, const size_t len) {
+            const char *start = begin;
+            const char *end = begin + len;
+
+            // Complete the line that is started in the previous buffer. The readers in reader.hpp only
+            // pass complete lines so this only happens with other callers.
+            if (!linebuf.empty()) {
+                const char *ptr = static_cast<const char *>(memchr(begin, EOL, len));
+                if (ptr == nullptr) {
+                    linebuf.append(begin, len);
+                    return;
+                }
+                linebuf.append(start, ptr - start + 1);
+                process_line(linebuf.data(), linebuf.size());
+                linebuf.clear();
+                start = ++ptr;
+                if (is_done()) return;
+            }
+
+            // Only scan complete lines and keep the leftover data in the line buffer.
+            const char *last = static_cast<const char *>(memrchr(start, EOL, end - start));
+            if (last != nullptr) {
+                scan(start, last + 1);
+                start = last + 1;
+            }
+            if ((start < end) && !is_done()) { linebuf.append(start, end - start); }
+        }
+
+        Console &get_console() { return console; }
+
+        // Return true if we do not need to search the current file anymore. We need to see all lines to
+        // count lines that do not match.
+        bool is_done() const { return !inverse && (max_count > 0) && (matches >= max_count); }
+
+        // The total number of counted lines in all searched files.
+        size_t number_of_matches() const { return total_matches; }
+
+        // Readers call this method if they skip lines that do not match. Skipped lines are counted by
+        // the inverse match.
+        void skip_lines(const size_t nlines) { lines += nlines; }
+
+      protected:
+        Scanner scanner;
+        std::string linebuf;
+        std::string result;
+        Console console;
+        bool color = false;
+        bool inverse = false;
+        bool quite = false;
+        size_t max_count = 0;
+        size_t lines = 0;
+        size_t matches = 0;
+        size_t total_matches = 0;
+        const char *file = nullptr;
+
+        // Count matched lines in a block of complete lines.
+        void scan(const char *begin, const char *end) {
+            const char *start = begin;
+            const char *match_end;
+            if (inverse) { lines += simd::count(begin, end, EOL); }
+            while ((start < end) && !is_done() && (match_end = scanner.find(start, end))) {
+                const char *last_char = (match_end > start) ? match_end - 1 : start;
+                const char *line_begin = static_cast<const char *>(memrchr(start, EOL, last_char - start));
+                line_begin = (line_begin == nullptr) ? start : line_begin + 1;
+                const char *line_end = static_cast<const char *>(memchr(last_char, EOL, end - last_char));
+                if (scanner.verify(line_begin, line_end - line_begin + 1)) { ++matches; }
+                start = line_end + 1;
+            }
+        }
+
+        void process_line(const char *begin, const size_t len) {
+            ++lines;
+            if (scanner.find(begin, begin + len) && scanner.verify(begin, len)) { ++matches; }
+        }
+
+        // Set the file name so we can display our results better. This method is called before we search
+        // a new file so we also reset all per-file states.
+        void set_filename(const char *fname) {
+            file = fname;
+            linebuf.clear();
+            lines = 0;
+            matches = 0;
+        }
+
+        // Process the last line if it does not end with EOL then print the number of counted lines.
+        void finalize() {
+            if (!linebuf.empty()) {
+                linebuf.push_back(EOL);
+                process_line(linebuf.data(), linebuf.size());
+                linebuf.clear();
+            }
+
+            size_t count = inverse ? (lines - matches) : matches;
+            if (max_count > 0) count = std::min(count, max_count);
+            total_matches += count;
+            if (!quite) {
+                if (file) {
+                    if (!color) {
+                        console.print_filename(file);
+                    } else {
+                        console.print_color_filename(file);
+                    }
+                }
+
+                // Consoles might only keep pointers to the printed data so they must be flushed before
+                // the result buffer is reused.
+                fmt::format_int str(count);
+                result.assign(str.data(), str.size());
+                if (!color) {
+                    console.print_plain_text(result.data(), result.data() + result.size());
+                } else {
+                    console.print_color_text(result.data(), result.data() + result.size());
+                }
+                console.flush();
+            }
+            lines = 0;
+            matches = 0;
+        }
+    };
+} // namespace fastgrep
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "hs/hs.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fastgrep {
+    namespace hyperscan {
+        // Compiled databases are cached in this folder. The cache is disabled if the folder name is empty
+        // and the default value is taken from the FASTGREP_CACHE_DIR environment variable.
+        inline std::string &cache_directory() {
+            static std::string folder = [] {
+                const char *env = getenv("FASTGREP_CACHE_DIR");
+                return std::string(env ? env : "");
+            }();
+            return folder;
+        }
+
+        // A cached database file has a fixed size header, the cache key, and the serialized database. The
+        // key is stored in the file so hash collisions and truncated files can be detected.
+        struct CacheHeader {
+            static constexpr size_t MAGIC_SIZE = 8;
+            char magic[MAGIC_SIZE];
+            uint64_t key_size;
+            uint64_t database_size;
+        };
+
+        inline const char *cache_magic() { return "FGREPDB1"; }
+
+        // The cache key includes everything that affects the compiled database: the hyperscan version,
+        // the CPU platform, the compile mode, flags, and all expressions.
+        inline std::string cache_key(const std::vector<std::string> &patterns, const unsigned int flags,
+                                     const unsigned int mode) {
+            hs_platform_info_t platform;
+            if (hs_populate_platform(&platform) != HS_SUCCESS) return std::string();
+            std::string key(hs_version());
+            key.push_back('\0');
+            const unsigned long long tune = platform.tune, features = platform.cpu_features;
+            key.append(reinterpret_cast<const char *>(&tune), sizeof(tune));
+            key.append(reinterpret_cast<const char *>(&features), sizeof(features));
+            key.append(reinterpret_cast<const char *>(&flags), sizeof(flags));
+            key.append(reinterpret_cast<const char *>(&mode), sizeof(mode));
+            for (auto const &patt : patterns) {
+                const uint64_t len = patt.size();
+                key.append(reinterpret_cast<const char *>(&len), sizeof(len));
+                key.append(patt);
+            }
+            return key;
+        }
+
+        // Use FNV-1a to get the name of a cached database file.
+        inline std::string cache_filename(const std::string &key) {
+            uint64_t hash = 14695981039346656037ULL;
+            for (const char c : key) {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ULL;
+            }
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%016llx.db", static_cast<unsigned long long>(hash));
+            return cache_directory() + "/" + buf;
+        }
+
+        // Load a database from the cache. Return nullptr if it is not available or it is invalid. The file
+        // is read into one buffer because hs_deserialize_database copies the database anyway.
+        inline hs_database_t *load_database(const std::string &fname, const std::string &key) {
+            int fd = ::open(fname.c_str(), O_RDONLY);
+            if (fd < 0) return nullptr;
+
+            struct stat buf;
+            if ((fstat(fd, &buf) < 0) || (static_cast<size_t>(buf.st_size) < sizeof(CacheHeader))) {
+                ::close(fd);
+                return nullptr;
+            }
+
+            const size_t size = buf.st_size;
+            std::vector<char> buffer(size);
+            size_t nread = 0;
+            while (nread < size) {
+                const ssize_t nbytes = ::read(fd, buffer.data() + nread, size - nread);
+                if ((nbytes < 0) && (errno == EINTR)) continue;
+                if (nbytes <= 0) break;
+                nread += nbytes;
+            }
+            ::close(fd);
+            if (nread != size) return nullptr;
+
+            // Check the header and the key before deserializing the database. hs_deserialize_database
+            // also checks the hyperscan version and the platform of the serialized database.
+            hs_database_t *database = nullptr;
+            const char *data = buffer.data();
+            CacheHeader header;
+            memcpy(&header, data, sizeof(header));
+            const bool is_valid = (memcmp(header.magic, cache_magic(), CacheHeader::MAGIC_SIZE) == 0) &&
+                                  (header.key_size == key.size()) &&
+                                  (sizeof(header) + header.key_size + header.database_size == size) &&
+                                  (memcmp(data + sizeof(header), key.data(), key.size()) == 0);
+            if (is_valid) {
+                const char *bytes = data + sizeof(header) + header.key_size;
+                if (hs_deserialize_database(bytes, header.database_size, &database) != HS_SUCCESS) {
+                    database = nullptr;
+                }
+            }
+            return database;
+        }
+
+        // Write the serialized database to a temporary file then rename it so readers never see a
+        // partially written file. Failures are ignored because the cache is only an optimization.
+        inline void save_database(const std::string &fname, const std::string &key,
+                                  const hs_database_t *database) {
+            char *bytes = nullptr;
+            size_t length = 0;
+            if (hs_serialize_database(database, &bytes, &length) != HS_SUCCESS) return;
+
+            CacheHeader header;
+            memcpy(header.magic, cache_magic(), CacheHeader::MAGIC_SIZE);
+            header.key_size = key.size();
+            header.database_size = length;
+
+            const size_t tid = std::hash<std::thread::id>()(std::this_thread::get_id());
+            std::string tmpfile = fname + "." + std::to_string(getpid()) + "." + std::to_string(tid);
+            FILE *fp = fopen(tmpfile.c_str(), "wb");
+            if (fp != nullptr) {
+                const bool is_ok = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                                   (fwrite(key.data(), 1, key.size(), fp) == key.size()) &&
+                                   (fwrite(bytes, 1, length, fp) == length);
+                if ((fclose(fp) == 0) && is_ok && (rename(tmpfile.c_str(), fname.c_str()) == 0)) {
+                    tmpfile.clear();
+                }
+                if (!tmpfile.empty()) unlink(tmpfile.c_str());
+            }
+            free(bytes);
+        }
+
+        // Compile all patterns into a block mode database using the same flags. The pattern ids are the
+        // pattern indexes. The compiled database is cached if the cache folder is set.
+        inline hs_database_t *compile(const std::vector<std::string> &patterns, const unsigned int flags) {
+            const bool use_cache = !cache_directory().empty();
+            std::string key, fname;
+            if (use_cache) {
+                key = cache_key(patterns, flags, HS_MODE_BLOCK);
+                if (!key.empty()) {
+                    fname = cache_filename(key);
+                    hs_database_t *database = load_database(fname, key);
+                    if (database != nullptr) return database;
+                }
+            }
+
+            std::vector<const char *> expressions;
+            std::vector<unsigned int> all_flags(patterns.size(), flags);
+            std::vector<unsigned int> ids;
+            for (size_t idx = 0; idx < patterns.size(); ++idx) {
+                expressions.push_back(patterns[idx].c_str());
+                ids.push_back(static_cast<unsigned int>(idx));
+            }
+
+            hs_database_t *database = nullptr;
+            hs_compile_error_t *compile_error = nullptr;
+            const unsigned int elements = static_cast<unsigned int>(patterns.size());
+            auto errcode = hs_compile_multi(expressions.data(), all_flags.data(), ids.data(), elements,
+                                            HS_MODE_BLOCK, nullptr, &database, &compile_error);
+            if (errcode != HS_SUCCESS) {
+                std::string errmsg = "Cannot compile the search pattern";
+                if ((compile_error->expression >= 0) &&
+                    (static_cast<size_t>(compile_error->expression) < patterns.size())) {
+                    errmsg += std::string(" \"") + patterns[compile_error->expression] + "\"";
+                }
+                errmsg += std::string(": ") + compile_error->message;
+                hs_free_compile_error(compile_error);
+                throw std::runtime_error(errmsg);
+            }
+
+            if (!fname.empty()) save_database(fname, key, database);
+            return database;
+        }
+    } // namespace hyperscan
+} // namespace fastgrep
@@ -0,0 +1,353 @@
+#pragma once
+
+#include "constants.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fastgrep {
+    // The first stage of simdjson: classify 64 bytes at a time into bitmaps of quotes, backslashes, and
+    // structural characters, find escaped characters using carries of the backslash sequences, and
+    // compute the in-string mask using a prefix xor of the unescaped quotes. Structural characters are
+    // only those outside of strings so the second stage can walk the tokens of a JSON object using
+    // ctz without looking at any other byte.
+    namespace json {
+        constexpr size_t BLOCK_SIZE = 64;
+
+        struct Masks {
+            uint64_t quote = 0;
+            uint64_t backslash = 0;
+            uint64_t structural = 0; // '{', '}', '[', ']', ':', and ','.
+        };
+
+        inline Masks classify_scalar(const char *data) {
+            Masks masks;
+            for (size_t idx = 0; idx < BLOCK_SIZE; ++idx) {
+                const uint64_t bit = 1ULL << idx;
+                switch (data[idx]) {
+                case '"':
+                    masks.quote |= bit;
+                    break;
+                case '\\':
+                    masks.backslash |= bit;
+                    break;
+                case '{':
+                case '}':
+                case '[':
+                case ']':
+                case ':':
+                case ',':
+                    masks.structural |= bit;
+                    break;
+                default:
+                    break;
+                }
+            }
+            return masks;
+        }
+
+#ifdef __SSE2__
+        inline Masks classify_sse2(const char *data) {
+            Masks masks;
+            auto mask = [](const __m128i x, const char c) {
+                const int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c)));
+                return static_cast<uint64_t>(static_cast<uint32_t>(bits));
+            };
+            for (size_t offset = 0; offset < BLOCK_SIZE; offset += 16) {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + offset));
+                const uint64_t structural = mask(x, '{') | mask(x, '}') | mask(x, '[') | mask(x, ']') |
+                                            mask(x, ':') | mask(x, ',');
+                masks.quote |= mask(x, '"') << offset;
+                masks.backslash |= mask(x, '\\') << offset;
+                masks.structural |= structural << offset;
+            }
+            return masks;
+        }
+#endif
+
+        inline Masks classify(const char *data) {
+#ifdef __SSE2__
+            return classify_sse2(data);
+#else
+            return classify_scalar(data);
+#endif
+        }
+
+        // Return the mask of the characters escaped by a backslash. A backslash sequence which starts
+        // at an even position escapes the character after it if its length is odd, and the carry of the
+        // sequence which ends at the last byte is passed to the next block.
+        inline uint64_t find_escaped(uint64_t backslash, uint64_t &prev_escaped) {
+            constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL;
+            backslash &= ~prev_escaped;
+            const uint64_t follows_escape = (backslash << 1) | prev_escaped;
+            const uint64_t odd_sequence_starts = backslash & ~EVEN_BITS & ~follows_escape;
+            uint64_t sequences_starting_on_even_bits;
+            prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash,
+                                                  &sequences_starting_on_even_bits);
+            const uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+            return (EVEN_BITS ^ invert_mask) & follows_escape;
+        }
+
+        // Bit i of the result is the xor of bits [0, i] of x.
+        inline uint64_t prefix_xor(uint64_t x) {
+            x ^= x << 1;
+            x ^= x << 2;
+            x ^= x << 4;
+            x ^= x << 8;
+            x ^= x << 16;
+            x ^= x << 32;
+            return x;
+        }
+
+        // The second stage: walk the tokens of the blocks of a JSON object using ctz. A key is a string
+        // which follows '{' or ',' at depth one and its value starts after the next ':'. The state is kept
+        // between blocks so keys and values can span blocks.
+        class Walker {
+          public:
+            enum class Status { STOPPED, DONE, MORE };
+
+            // Walk a block and call visit(key, key_len, value, value_len) for each top-level field whose
+            // value is a string, a number, a boolean, or null. Return STOPPED if visit returns true and
+            // DONE at the end of the object.
+            template <typename Visitor> Status walk(const char *block, const Masks &masks, Visitor &visit) {
+                const uint64_t escaped = find_escaped(masks.backslash, prev_escaped);
+                const uint64_t quote = masks.quote & ~escaped;
+                const uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+                prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+                uint64_t tokens = (masks.structural & ~in_string) | quote;
+                while (tokens != 0) {
+                    const size_t pos = __builtin_ctzll(tokens);
+                    tokens &= tokens - 1;
+                    const char *ptr = block + pos;
+                    const bool is_quote = (quote >> pos) & 1;
+                    if (is_quote) {
+                        const bool is_opening = (in_string >> pos) & 1;
+                        if (depth != 1) continue;
+                        if (is_opening) {
+                            if (expect_key) {
+                                state = State::KEY;
+                                expect_key = false;
+                            } else if (state == State::VALUE) {
+                                state = State::STRING_VALUE;
+                            }
+                            token = ptr + 1;
+                        } else if (state == State::KEY) {
+                            key = token;
+                            key_len = ptr - token;
+                            has_key = true;
+                            state = State::NONE;
+                        } else if (state == State::STRING_VALUE) {
+                            if (emit(visit, ptr)) return Status::STOPPED;
+                        }
+                        continue;
+                    }
+
+                    switch (*ptr) {
+                    case '{':
+                    case '[':
+                        if (depth == 0) expect_key = (*ptr == '{');
+                        state = State::NONE;
+                        ++depth;
+                        break;
+                    case '}':
+                    case ']':
+                        if ((depth == 1) && (state == State::VALUE) && emit(visit, ptr)) {
+                            return Status::STOPPED;
+                        }
+                        state = State::NONE;
+                        if ((depth > 0) && (--depth == 0)) return Status::DONE;
+                        break;
+                    case ':':
+                        if ((depth == 1) && has_key) {
+                            state = State::VALUE;
+                            token = ptr + 1;
+                        }
+                        break;
+                    case ',':
+                        if (depth == 1) {
+                            if ((state == State::VALUE) && emit(visit, ptr)) return Status::STOPPED;
+                            state = State::NONE;
+                            has_key = false;
+                            expect_key = true;
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                return Status::MORE;
+            }
+
+          private:
+            enum class State { NONE, KEY, VALUE, STRING_VALUE };
+            uint64_t prev_escaped = 0;
+            uint64_t prev_in_string = 0;
+            size_t depth = 0;
+            bool expect_key = false;
+            bool has_key = false;
+            State state = State::NONE;
+            const char *token = nullptr; // The beginning of the current key or value.
+            const char *key = nullptr;
+            size_t key_len = 0;
+
+            // Pass the current field to the visitor. Values which are not strings are trimmed.
+            template <typename Visitor> bool emit(Visitor &visit, const char *end) {
+                const char *begin = token;
+                if (state == State::VALUE) {
+                    auto is_space = [](const char c) { return (c == ' ') || (c == '\t') || (c == '\r'); };
+                    while ((begin < end) && is_space(*begin)) ++begin;
+                    while ((end > begin) && is_space(end[-1])) --end;
+                }
+                state = State::NONE;
+                has_key = false;
+                return visit(key, key_len, begin, static_cast<size_t>(end - begin));
+            }
+        };
+
+        // Call visit(key, key_len, value, value_len) for each top-level field of the JSON object which
+        // starts at the first '{' of [begin, end) until it returns true. String values are given without
+        // their quotes and are not unescaped, and nested objects and arrays are skipped. Return true if
+        // the visitor stops the walk.
+        template <typename Visitor>
+        bool for_each_field(const char *begin, const char *end, Visitor &&visit) {
+            const char *object = simd::find_char(begin, end, '{');
+            if (object == nullptr) return false;
+
+            Walker walker;
+            char padded[BLOCK_SIZE];
+            for (const char *block = object; block < end; block += BLOCK_SIZE) {
+                const char *data = block;
+                const size_t len = std::min<size_t>(BLOCK_SIZE, end - block);
+                if (len < BLOCK_SIZE) {
+                    memcpy(padded, block, len);
+                    memset(padded + len, ' ', BLOCK_SIZE - len);
+                    data = padded;
+                }
+                switch (walker.walk(block, classify(data), visit)) {
+                case Walker::Status::STOPPED:
+                    return true;
+                case Walker::Status::DONE:
+                    return false;
+                default:
+                    break;
+                }
+            }
+            return false;
+        }
+    } // namespace json
+
+    // FieldConstraints keeps the lines whose JSON objects have the given values of top-level keys, e.g
+    // LEVEL=error. Constraints of the same key are alternatives and constraints of different keys must
+    // all be satisfied. The JSON object of a line starts at its first '{' so scribe headers are skipped.
+    //
+    // Lines are found using a SIMD search for the most selective value and only candidate lines are
+    // scanned. The scan walks the structural characters found by the first stage of simdjson and
+    // compares the values of the requested keys at depth one in place, i.e no DOM is built and nested
+    // objects are never parsed. String values are compared with their raw, not unescaped, content and
+    // other values are compared with their literal text.
+    class FieldConstraints {
+      public:
+        // Add a KEY=VALUE constraint.
+        void add(const std::string &constraint) {
+            const size_t pos = constraint.find('=');
+            if ((pos == std::string::npos) || (pos == 0)) {
+                throw std::runtime_error("Invalid field constraint: " + constraint);
+            }
+            const std::string key = constraint.substr(0, pos);
+            auto it = std::find_if(fields.begin(), fields.end(),
+                                   [&key](const Field &item) { return item.key == key; });
+            if (it == fields.end()) {
+                if (fields.size() == MAX_FIELDS) throw std::runtime_error("Too many constrained fields.");
+                it = fields.insert(fields.end(), Field{key, {}});
+            }
+            it->values.push_back(constraint.substr(pos + 1));
+            update_needle();
+        }
+
+        bool empty() const { return fields.empty(); }
+
+        // Pass each run of complete lines which satisfy all constraints to process.
+        template <typename Process> void filter(const char *begin, const char *end, Process &&process) {
+            const char *run = nullptr;
+            const char *run_end = nullptr;
+            const char *start = begin;
+            while (start < end) {
+                const char *candidate = simd::find(start, end, needle.data(), needle.size());
+                if (candidate == nullptr) break;
+                const char *line_begin = static_cast<const char *>(memrchr(start, EOL, candidate - start));
+                line_begin = (line_begin == nullptr) ? start : line_begin + 1;
+                const char *eol = simd::find_char(candidate, end, EOL);
+                const char *line_end = (eol == nullptr) ? end : eol;
+                const char *next = (eol == nullptr) ? end : eol + 1;
+                if (is_matched(line_begin, line_end)) {
+                    if (run_end != line_begin) {
+                        if (run != nullptr) process(run, run_end - run);
+                        run = line_begin;
+                    }
+                    run_end = next;
+                }
+                start = next;
+            }
+            if (run != nullptr) process(run, run_end - run);
+        }
+
+        // Return true if the JSON object of a line satisfies all constraints.
+        bool is_matched(const char *begin, const char *end) const {
+            uint64_t found = 0; // The fields which have been found with an accepted value.
+            auto visit = [this, &found](const char *key, const size_t key_len, const char *value,
+                                        const size_t len) {
+                const Field *field = find_field(key, key_len);
+                if (field == nullptr) return false;
+                for (auto const &item : field->values) {
+                    if ((item.size() == len) && (memcmp(item.data(), value, len) == 0)) {
+                        found |= 1ULL << (field - fields.data());
+                        break;
+                    }
+                }
+                return found == all_fields();
+            };
+            return json::for_each_field(begin, end, visit);
+        }
+
+      private:
+        static constexpr size_t MAX_FIELDS = 64;
+        struct Field {
+            std::string key;
+            std::vector<std::string> values;
+        };
+        std::vector<Field> fields;
+        std::string needle;
+
+        // Use the longest value of a key which has only one accepted value as the needle. Otherwise use
+        // the quoted name of the first key.
+        void update_needle() {
+            needle = "\"" + fields.front().key + "\"";
+            size_t len = 0;
+            for (auto const &item : fields) {
+                if ((item.values.size() == 1) && (item.values.front().size() > len)) {
+                    needle = item.values.front();
+                    len = needle.size();
+                }
+            }
+        }
+
+        uint64_t all_fields() const {
+            return (fields.size() == MAX_FIELDS) ? ~0ULL : ((1ULL << fields.size()) - 1);
+        }
+
+        const Field *find_field(const char *begin, const size_t len) const {
+            for (auto const &item : fields) {
+                if ((item.key.size() == len) && (memcmp(item.key.data(), begin, len) == 0)) return &item;
+            }
+            return nullptr;
+        }
+    };
+} // namespace fastgrep
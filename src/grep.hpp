@@ -1,9 +1,11 @@
 #pragma once
 
 #include "fmt/format.h"
+#include "scan_policy.hpp"
 #include "simple_policy.hpp"
 #include "stream.hpp"
 #include "utils/memchr.hpp"
+#include <cstdio>
 #include <cstring>
 #include <string>
 
@@ -19,9 +21,7 @@ namespace fastgrep {
                 const char *end = begin + len;
                 const char *ptr = begin;
                 while ((ptr = static_cast<const char *>(memchr(ptr, EOL, end - ptr)))) {
-                    linebuf.append(start, ptr - start + 1);
-                    process_linebuf();
-                    linebuf.clear();
+                    process_line(start, ptr - start + 1);
 
                     // Update parameters
                     start = ++ptr;
@@ -31,22 +31,22 @@ namespace fastgrep {
                     if (start == end) break;
                 }
 
-                // Update the line buffer with leftover data.
-                if (start != end) {
-                    linebuf.append(start, end - start);
-                    process_linebuf();
-                }
+                // Process the leftover data.
+                if (start != end) { process_line(start, end - start); }
                 pos += len;
             }
 
             Matcher matcher;
-            std::string linebuf;
             size_t lines = 0;
             size_t pos = 0;
 
           protected:
-            void process_linebuf() {
-                if (matcher.is_matched(linebuf)) { fmt::print("{0}:{1}", lines, linebuf); }
+            // Lines are matched in place instead of being copied to a line buffer.
+            void process_line(const char *begin, const size_t len) {
+                if (matcher.is_matched(begin, len)) {
+                    fmt::print("{0}:", lines);
+                    fwrite(begin, 1, len, stdout);
+                }
             }
         };
 
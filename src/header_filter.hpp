@@ -0,0 +1,141 @@
+#pragma once
+
+#include "constants.hpp"
+#include "simd.hpp"
+#include "timestamp.hpp"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace fastgrep {
+    // The header of a scribe message is "mm-dd-yyyy hh:mm:ss node pool ..." and the lines which do not
+    // start with a timestamp are the continuation lines of the previous message.
+    namespace header {
+        constexpr size_t NODE_FIELD = 0; // The index of the node name in the fields after the timestamp.
+        constexpr size_t POOL_FIELD = 1;
+
+        // A field predicate accepts a field if it is equal to one of the given values. A value which ends
+        // with '*' accepts all fields which start with it.
+        class FieldPredicate {
+          public:
+            explicit FieldPredicate(const size_t index) : index(index) {}
+
+            void add(const std::string &value) {
+                const bool is_prefix = !value.empty() && (value.back() == '*');
+                const std::string text = is_prefix ? value.substr(0, value.size() - 1) : value;
+                values.emplace_back(Value{text, is_prefix});
+            }
+
+            bool empty() const { return values.empty(); }
+
+            bool operator()(const char *begin, const size_t len) const {
+                for (auto const &item : values) {
+                    const size_t size = item.text.size();
+                    if (((len == size) || (item.is_prefix && (len > size))) &&
+                        (memcmp(begin, item.text.data(), size) == 0)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            size_t index;
+
+          private:
+            struct Value {
+                std::string text;
+                bool is_prefix;
+            };
+            std::vector<Value> values;
+        };
+    } // namespace header
+
+    // HeaderConstraints checks the headers of messages in place so rejected messages are never copied
+    // or matched against search patterns. A message is accepted if its timestamp is in the time window,
+    // if any, and each constrained field has one of its accepted values. The constraints are checked
+    // from the cheapest one: the timestamp is parsed using SIMD digit conversion and the fields are only
+    // located using SIMD if the timestamp is accepted.
+    class HeaderConstraints {
+      public:
+        void set_time_range(const int64_t begin, const int64_t end) {
+            begin_time = begin;
+            end_time = end;
+            has_time_range = true;
+        }
+
+        void add_node(const std::string &value) { node.add(value); }
+        void add_pool(const std::string &value) { pool.add(value); }
+
+        bool empty() const { return !has_time_range && node.empty() && pool.empty(); }
+
+        // Forget the state of the previous file. Lines before the first header are rejected.
+        void reset() { is_accepted = false; }
+
+        // Pass each run of complete lines of accepted messages to process. A message can span several
+        // calls so the decision of its header is kept for its continuation lines.
+        template <typename Process> void filter(const char *begin, const char *end, Process &&process) {
+            const char *run = is_accepted ? begin : nullptr;
+            const char *start = begin;
+            while (start < end) {
+                const char *eol = simd::find_char(start, end, EOL);
+                const char *line_end = (eol == nullptr) ? end : eol;
+                int64_t value;
+                if (timestamp::parse(start, line_end, value)) {
+                    const bool accepted = is_accepted_header(start, line_end, value);
+                    if (accepted && (run == nullptr)) {
+                        run = start;
+                    } else if (!accepted && (run != nullptr)) {
+                        process(run, start - run);
+                        run = nullptr;
+                    }
+                    is_accepted = accepted;
+                }
+                start = (eol == nullptr) ? end : eol + 1;
+            }
+            if (run != nullptr) process(run, end - run);
+        }
+
+        // Return true if a header line which has the given timestamp satisfies all constraints.
+        bool is_accepted_header(const char *begin, const char *end, const int64_t value) const {
+            if (has_time_range && ((value < begin_time) || (value > end_time))) return false;
+            if (node.empty() && pool.empty()) return true;
+
+            // Fields are separated by a single space.
+            const char *fields[MAX_FIELDS + 1];
+            const size_t nfields = find_fields(begin + timestamp::TIMESTAMP_LENGTH, end, fields);
+            auto check = [&fields, nfields](const header::FieldPredicate &pred) {
+                if (pred.empty()) return true;
+                if (pred.index >= nfields) return false;
+                return pred(fields[pred.index], fields[pred.index + 1] - fields[pred.index] - 1);
+            };
+            return check(node) && check(pool);
+        }
+
+      private:
+        static constexpr size_t MAX_FIELDS = 2;
+        int64_t begin_time = std::numeric_limits<int64_t>::min();
+        int64_t end_time = std::numeric_limits<int64_t>::max();
+        bool has_time_range = false;
+        header::FieldPredicate node{header::NODE_FIELD};
+        header::FieldPredicate pool{header::POOL_FIELD};
+        bool is_accepted = false;
+
+        // Find the first fields after the timestamp. fields[i] is the beginning of field i and each field
+        // ends right before the beginning of the next one minus one. Return the number of found fields.
+        static size_t find_fields(const char *begin, const char *end, const char **fields) {
+            if ((begin >= end) || (*begin != ' ')) return 0;
+            const char *ptr = begin + 1;
+            size_t nfields = 0;
+            fields[0] = ptr;
+            while (nfields < MAX_FIELDS) {
+                const char *space = simd::find_char(ptr, end, ' ');
+                fields[++nfields] = ((space == nullptr) ? end : space) + 1;
+                if (space == nullptr) break;
+                ptr = space + 1;
+            }
+            return nfields;
+        }
+    };
+} // namespace fastgrep
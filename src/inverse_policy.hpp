@@ -0,0 +1,229 @@
+#pragma once
+
+#include "constants.hpp"
+#include "fmt/format.h"
+#include "line_index.hpp"
+#include "output.hpp"
+#include "scanners.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace fastgrep {
+    // InversePolicy prints lines that do not match the given pattern. It scans all complete lines of a
+    // buffer using a single scanner call and the gaps between matched lines are printed as contiguous
+    // byte ranges. If lines need a file name or a line number prefix then the prefixed gaps of a buffer
+    // are collected in a line buffer and printed using one console call. Lines are only printed one by
+    // one if they are colored or if we need to stop after max_count lines.
+    template <typename Scanner, typename Console = FMTPolicy> class InversePolicy {
+      public:
+        template <typename Params>
+        InversePolicy(const std::string &patt, Params &&params)
+            : scanner(patt, params.regex_mode), lines(1), pos(0), linebuf(), console(),
+              color(params.color()), linenum(params.linenum()), quite(params.quite()),
+              files_with_matches(params.files_with_matches()),
+              max_count((quite || files_with_matches) ? 1 : params.max_count) {}
+
+        void process(const char *begin, const size_t len) {
+            const char *start = begin;
+            const char *end = begin + len;
+
+            // Complete the line that is started in the previous buffer. The readers in reader.hpp only
+            // pass complete lines so this only happens with other callers.
+            if (!linebuf.empty()) {
+                const char *ptr = static_cast<const char *>(memchr(begin, EOL, len));
+                if (ptr == nullptr) {
+                    linebuf.append(begin, len);
+                    pos += len;
+                    return;
+                }
+                linebuf.append(start, ptr - start + 1);
+                process_line(linebuf.data(), linebuf.size());
+                flush();
+                linebuf.clear();
+                start = ++ptr;
+                if (is_done()) return;
+            }
+
+            // Only scan complete lines and keep the leftover data in the line buffer.
+            const char *last = static_cast<const char *>(memrchr(start, EOL, end - start));
+            if (last != nullptr) {
+                scan(start, last + 1);
+                start = last + 1;
+            }
+            if ((start < end) && !is_done()) { linebuf.append(start, end - start); }
+            pos += len;
+            flush();
+        }
+
+        Console &get_console() { return console; }
+
+        // Return true if we do not need to search the current file anymore.
+        bool is_done() const { return (max_count > 0) && (matches >= max_count); }
+
+        // The total number of printed lines in all searched files.
+        size_t number_of_matches() const { return total_matches; }
+
+      protected:
+        Scanner scanner;
+        LineIndex index;
+        size_t lines = 1;
+        size_t pos = 0;
+        std::string linebuf;
+        Console console;
+        bool color = false;
+        bool linenum = false;
+        bool quite = false;
+        bool files_with_matches = false;
+        size_t max_count = 0;
+        size_t matches = 0;
+        size_t total_matches = 0;
+        const char *file = nullptr;
+        std::string prefixed;
+
+        // Scan a block of complete lines and print all lines between matched lines. A candidate line
+        // that cannot be verified is a part of the current gap. The EOL index of the block gives us the
+        // boundaries of candidate lines and of the printed lines.
+        void scan(const char *begin, const char *end) {
+            const char *start = begin;
+            const char *gap = begin;
+            const char *match_end;
+            index.build(begin, end);
+            while ((start < end) && !is_done() && (match_end = scanner.find(start, end))) {
+                const char *last_char = (match_end > start) ? match_end - 1 : start;
+                const char *line_begin = index.prev(last_char);
+                line_begin = (line_begin == nullptr) ? start : line_begin + 1;
+                const char *line_end = index.next(last_char);
+                if (scanner.verify(line_begin, line_end - line_begin + 1)) {
+                    print_lines(gap, line_begin);
+                    if (linenum) ++lines;
+                    gap = line_end + 1;
+                }
+                start = line_end + 1;
+            }
+            if (!is_done()) print_lines(gap, end);
+        }
+
+        void process_line(const char *begin, const size_t len) {
+            if (!(scanner.find(begin, begin + len) && scanner.verify(begin, len))) {
+                index.build(begin, begin + len);
+                print_lines(begin, begin + len);
+            } else if (linenum) {
+                ++lines;
+            }
+        }
+
+        // Print a range of complete lines which is covered by the EOL index.
+        void print_lines(const char *begin, const char *end) {
+            if (begin >= end) return;
+            if (quite || files_with_matches) {
+                ++matches;
+                ++total_matches;
+                if (files_with_matches) {
+                    const char *fname = file ? file : "(standard input)";
+                    console.print_plain_text(fname, fname + strlen(fname));
+                }
+                return;
+            }
+
+            // The whole range is printed using one console call if lines do not have any prefix. Prefixed
+            // lines are copied to the prefixed buffer which is printed when the console is flushed.
+            if (!color && (max_count == 0)) {
+                if ((file == nullptr) && !linenum) {
+                    const size_t nlines = index.count(begin, end);
+                    matches += nlines;
+                    total_matches += nlines;
+                    console.print_plain_text(begin, end - 1);
+                } else {
+                    append_lines(begin, end);
+                }
+                return;
+            }
+
+            const char *start = begin;
+            while ((start < end) && !is_done()) {
+                const char *line_end = index.next(start);
+                print_line(start, line_end - start);
+                ++matches;
+                ++total_matches;
+                if (linenum) ++lines;
+                start = line_end + 1;
+            }
+        }
+
+        // Copy a range of complete lines to the prefixed buffer and add the file name and the line number
+        // in the same format as the console does.
+        void append_lines(const char *begin, const char *end) {
+            const size_t flen = (file != nullptr) ? strlen(file) : 0;
+            const char *start = begin;
+            while (start < end) {
+                const char *line_end = index.next(start);
+                if (file) {
+                    prefixed.append(file, flen);
+                    prefixed.push_back(':');
+                }
+                if (linenum) {
+                    fmt::format_int str(lines++);
+                    prefixed.append(str.data(), str.size());
+                    prefixed.push_back(':');
+                }
+                prefixed.append(start, line_end - start + 1);
+                ++matches;
+                ++total_matches;
+                start = line_end + 1;
+            }
+        }
+
+        // Print the prefixed lines and flush the console. The buffer can only be cleared after the flush
+        // because WritevPolicy points to it. The console adds the last EOL.
+        void flush() {
+            if (!prefixed.empty()) {
+                console.print_plain_text(prefixed.data(), prefixed.data() + prefixed.size() - 1);
+            }
+            console.flush();
+            prefixed.clear();
+        }
+
+        void print_line(const char *begin, const size_t len) {
+            if (!linenum) {
+                if (!color) {
+                    if (file) { console.print_filename(file); }
+                    console.print_plain_text(begin, begin + len);
+                } else {
+                    if (file) { console.print_color_filename(file); }
+                    console.print_color_text(begin, begin + len);
+                }
+            } else {
+                if (!color) {
+                    if (file) { console.print_filename(file); }
+                    console.print_plain_text(begin, begin + len, lines);
+                } else {
+                    if (file) { console.print_color_filename(file); }
+                    console.print_color_text(begin, begin + len, lines);
+                }
+            }
+        }
+
+        // Set the file name so we can display our results better. This method is called before we search
+        // a new file so we also reset all per-file states.
+        void set_filename(const char *fname) {
+            file = fname;
+            linebuf.clear();
+            lines = 1;
+            pos = 0;
+            matches = 0;
+        }
+
+        // Process the last line if it does not end with EOL.
+        void finalize() {
+            if (!linebuf.empty()) {
+                linebuf.push_back(EOL);
+                process_line(linebuf.data(), linebuf.size());
+                flush();
+                linebuf.clear();
+            }
+            lines = 1;
+            pos = 0;
+        }
+    };
+} // namespace fastgrep
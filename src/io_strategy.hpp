@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fastgrep {
+    // READ_AHEAD reads the next blocks of a file in a separate thread while the current block is searched.
+    enum class IOMethod { READ, MMAP, DIRECT, READ_AHEAD };
+
+    struct IOStrategy {
+        IOMethod method = IOMethod::READ;
+        size_t buffer_size = 1 << 16; // The read size of READ, READ_AHEAD, and DIRECT.
+        bool willneed = false;        // Ask the kernel to read ahead the whole mapped file.
+    };
+
+    // Thresholds of the I/O strategy selector. They are picked using benchmark/io_bench.cpp, for example
+    // a 256MB file takes 253ms with mmap and 306ms with 1MB reads if it is in the page cache, and 489ms
+    // with mmap, 287ms with 1MB reads, and 561ms with 64KB reads if it is not.
+    namespace io {
+        constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 16;
+        constexpr size_t LARGE_BUFFER_SIZE = 1 << 20;
+        constexpr size_t DIRECT_BUFFER_SIZE = 1 << 22;
+
+        // There is no difference between mmap and read for small files so we use a single read call.
+        constexpr size_t MMAP_THRESHOLD = 1 << 20;
+
+        // O_DIRECT is slower than 1MB reads for files which fit into the page cache, so it is only used
+        // for very big files which are not in the page cache to avoid evicting more useful pages. Cold
+        // reads of 1GB and 2GB files take about the same time with both methods, i.e 1.1s and 2.3s on a
+        // 5GB VM, so the threshold is where a search starts to replace a big part of the page cache.
+        constexpr size_t DIRECT_THRESHOLD = size_t(1) << 30;
+
+        // A file is considered cached if at least half of the sampled pages are in the page cache.
+        constexpr double RESIDENT_RATIO = 0.5;
+
+        // The maximum number of pages checked by mincore.
+        constexpr size_t MAX_SAMPLE_PAGES = 1 << 16;
+
+        // Network and user space file systems do not work well with mmap: page faults are expensive and
+        // a truncated file causes SIGBUS.
+        inline bool is_remote(const int fd) {
+            struct statfs buf;
+            if (fstatfs(fd, &buf) < 0) return false;
+            switch (static_cast<unsigned long>(buf.f_type)) {
+            case 0x6969:     // NFS
+            case 0x517B:     // SMB
+            case 0xFF534D42: // CIFS
+            case 0xFE534D42: // SMB2
+            case 0x65735546: // FUSE
+            case 0x01021997: // 9P
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // Return the ratio of pages in the first part of a file that are in the page cache.
+        inline double resident_ratio(const int fd, const size_t size) {
+            const size_t page_size = sysconf(_SC_PAGESIZE);
+            const size_t len = std::min(size, MAX_SAMPLE_PAGES * page_size);
+            void *mapped = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) return 0;
+            std::vector<unsigned char> pages((len + page_size - 1) / page_size);
+            double ratio = 0;
+            if (mincore(mapped, len, pages.data()) == 0) {
+                const size_t count =
+                    std::count_if(pages.begin(), pages.end(), [](const unsigned char c) { return c & 1; });
+                ratio = static_cast<double>(count) / pages.size();
+            }
+            munmap(mapped, len);
+            return ratio;
+        }
+    } // namespace io
+
+    // Select the I/O strategy of a file using its size, its file system, and its page cache residency.
+    // The buffer_size is the read size given by users and it is used for small and remote files.
+    inline IOStrategy select_io_strategy(const int fd, const struct stat &info, const size_t buffer_size) {
+        IOStrategy strategy;
+        strategy.buffer_size = buffer_size;
+
+        // Pipes and special files such as those in /proc do not have a meaningful size.
+        if (!S_ISREG(info.st_mode) || (info.st_size == 0)) return strategy;
+        const size_t size = info.st_size;
+
+        // Read a small file using a single read call.
+        if (size < io::MMAP_THRESHOLD) {
+            strategy.buffer_size = std::min(buffer_size, size + 1);
+            return strategy;
+        }
+
+        // Reads of remote files are slow so we search the current block while reading the next one.
+        if (io::is_remote(fd)) {
+            strategy.method = IOMethod::READ_AHEAD;
+            strategy.buffer_size = std::max(buffer_size, io::LARGE_BUFFER_SIZE);
+            return strategy;
+        }
+
+        const double ratio = io::resident_ratio(fd, size);
+        if (ratio >= io::RESIDENT_RATIO) {
+            strategy.method = IOMethod::MMAP;
+            strategy.willneed = ratio < 1.0;
+        } else if (size >= io::DIRECT_THRESHOLD) {
+            strategy.method = IOMethod::DIRECT;
+            strategy.buffer_size = std::max(buffer_size, io::DIRECT_BUFFER_SIZE);
+        } else {
+            strategy.method = IOMethod::READ_AHEAD;
+            strategy.buffer_size = std::max(buffer_size, io::LARGE_BUFFER_SIZE);
+        }
+        return strategy;
+    }
+} // namespace fastgrep
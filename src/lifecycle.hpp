@@ -0,0 +1,323 @@
+#pragma once
+
+#include "constants.hpp"
+#include "field_filter.hpp"
+#include "fmt/format.h"
+#include "simd.hpp"
+#include "timestamp.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fastgrep {
+    // Track the lifecycle of messages in scribe logs. The header line of each message has a JSON payload
+    // with the id of a message and the subject of the event, and events are classified as publish
+    // requests, control messages, e.g acknowledgements, or errors.
+    namespace lifecycle {
+        constexpr size_t ID_LENGTH = 20;
+        constexpr size_t NTYPES = 3;
+
+        enum MessageType : uint8_t { PUBLISH = 0, CONTROL = 1, ERROR = 2 };
+
+        // A fixed size message id. Shorter ids are padded with zeros.
+        struct MessageId {
+            char data[ID_LENGTH];
+
+            // Return false if the id is empty or longer than ID_LENGTH.
+            bool assign(const char *begin, const size_t len) {
+                if ((len == 0) || (len > ID_LENGTH)) return false;
+                memcpy(data, begin, len);
+                memset(data + len, 0, ID_LENGTH - len);
+                return true;
+            }
+
+            std::string to_string() const { return std::string(data, strnlen(data, ID_LENGTH)); }
+        };
+
+        inline bool operator==(const MessageId &lhs, const MessageId &rhs) {
+            return memcmp(lhs.data, rhs.data, ID_LENGTH) == 0;
+        }
+
+        // Mix the three words of an id using the finalizer of splitmix64.
+        inline uint64_t hash(const MessageId &id) {
+            uint64_t a, b;
+            uint32_t c;
+            memcpy(&a, id.data, sizeof(a));
+            memcpy(&b, id.data + 8, sizeof(b));
+            memcpy(&c, id.data + 16, sizeof(c));
+            uint64_t h = (a ^ 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+            h = (h ^ b ^ (h >> 29)) * 0x94D049BB133111EBULL;
+            h = (h ^ c ^ (h >> 32)) * 0xBF58476D1CE4E5B9ULL;
+            return h ^ (h >> 31);
+        }
+
+        // An open-addressing hash table with linear probing whose keys are message ids. Keys and values
+        // are stored inline in a single array so a new message does not allocate any memory unless the
+        // table grows. The capacity is a power of two and the table doubles when it is 3/4 full.
+        template <typename Value> class FlatTable {
+          public:
+            explicit FlatTable(const size_t capacity = 1 << 10) : slots(round_up(capacity)) {}
+
+            // Return the value of an id. The value is default constructed if the id is not in the table.
+            Value &operator[](const MessageId &id) {
+                if (4 * (count + 1) > 3 * slots.size()) grow();
+                Slot &slot = find(slots, id);
+                if (!slot.used) {
+                    slot.used = true;
+                    slot.id = id;
+                    slot.value = Value();
+                    ++count;
+                }
+                return slot.value;
+            }
+
+            // Return nullptr if the id is not in the table.
+            const Value *find(const MessageId &id) const {
+                const size_t mask = slots.size() - 1;
+                for (size_t pos = hash(id) & mask;; pos = (pos + 1) & mask) {
+                    const Slot &slot = slots[pos];
+                    if (!slot.used) return nullptr;
+                    if (slot.id == id) return &slot.value;
+                }
+            }
+
+            size_t size() const { return count; }
+            size_t capacity() const { return slots.size(); }
+
+            // Call fn(id, value) for each message in the table.
+            template <typename Function> void for_each(Function &&fn) const {
+                for (auto const &slot : slots) {
+                    if (slot.used) fn(slot.id, slot.value);
+                }
+            }
+
+          private:
+            struct Slot {
+                MessageId id;
+                bool used = false;
+                Value value;
+            };
+            std::vector<Slot> slots;
+            size_t count = 0;
+
+            static size_t round_up(const size_t capacity) {
+                size_t results = 2;
+                while (results < capacity) results <<= 1;
+                return results;
+            }
+
+            // Return the slot of an id or the empty slot where it should be inserted.
+            static Slot &find(std::vector<Slot> &table, const MessageId &id) {
+                const size_t mask = table.size() - 1;
+                for (size_t pos = hash(id) & mask;; pos = (pos + 1) & mask) {
+                    Slot &slot = table[pos];
+                    if (!slot.used || (slot.id == id)) return slot;
+                }
+            }
+
+            void grow() {
+                std::vector<Slot> table(2 * slots.size());
+                for (auto &slot : slots) {
+                    if (slot.used) find(table, slot.id) = std::move(slot);
+                }
+                slots.swap(table);
+            }
+        };
+
+        // The lifecycle of a message.
+        struct Record {
+            int64_t publish_time = 0; // The time of the first publish request.
+            int64_t control_time = 0; // The time of the last control message.
+            int64_t last_time = std::numeric_limits<int64_t>::min(); // The time of the last event.
+            uint32_t counts[NTYPES] = {0, 0, 0};
+            MessageType last_type = PUBLISH;
+
+            bool is_published() const { return counts[PUBLISH] > 0; }
+
+            // A message is delivered if it has a control message after its publish request.
+            bool is_delivered() const {
+                return is_published() && (counts[CONTROL] > 0) && (control_time >= publish_time);
+            }
+        };
+
+        struct Options {
+            std::string id_key = "ID";           // The key of message ids.
+            std::string subject_key = "SUBJECT"; // The subject of an event, e.g publish.
+            std::string level_key = "LEVEL";     // Events whose level is error are errors.
+            int64_t stuck_after = 300;           // The number of seconds after which a message is stuck.
+            size_t max_stuck = 20;               // The maximum number of reported stuck messages.
+        };
+
+        // Classify an event using its subject and level.
+        inline MessageType classify(const char *subject, const size_t subject_len, const char *level,
+                                    const size_t level_len) {
+            constexpr char ERROR_TEXT[] = "error";
+            constexpr size_t ERROR_LEN = sizeof(ERROR_TEXT) - 1;
+            if ((level_len == ERROR_LEN) && (memcmp(level, ERROR_TEXT, ERROR_LEN) == 0)) return ERROR;
+            if ((subject_len >= ERROR_LEN) &&
+                (memcmp(subject + subject_len - ERROR_LEN, ERROR_TEXT, ERROR_LEN) == 0)) {
+                return ERROR;
+            }
+            if ((subject_len == 7) && (memcmp(subject, "publish", 7) == 0)) return PUBLISH;
+            return CONTROL;
+        }
+    } // namespace lifecycle
+
+    // LifecycleTracker builds the lifecycle of all messages in one pass. It gets complete lines like a
+    // policy and only the header lines of messages are parsed: the timestamp is parsed using SIMD and the
+    // id, subject, and level fields are extracted from the JSON payload in place. Messages are kept in a
+    // flat table of 64 byte slots which is between 3/8 and 3/4 full, i.e 85 to 170 bytes per message.
+    class LifecycleTracker {
+      public:
+        explicit LifecycleTracker(const lifecycle::Options &opts = lifecycle::Options())
+            : options(opts) {}
+
+        void process(const char *begin, const size_t len) {
+            const char *start = begin;
+            const char *end = begin + len;
+            while (start < end) {
+                const char *eol = simd::find_char(start, end, EOL);
+                const char *line_end = (eol == nullptr) ? end : eol;
+                int64_t value;
+                if (timestamp::parse(start, line_end, value)) process_header(start, line_end, value);
+                start = (eol == nullptr) ? end : eol + 1;
+            }
+        }
+
+        void finalize() {}
+
+        size_t number_of_messages() const { return table.size(); }
+        const lifecycle::Record *find(const lifecycle::MessageId &id) const { return table.find(id); }
+
+        // Return the latencies, i.e the number of seconds between the first publish request and the last
+        // control message, of all delivered messages in ascending order.
+        std::vector<int64_t> latencies() const {
+            std::vector<int64_t> results;
+            table.for_each([&results](const lifecycle::MessageId &, const lifecycle::Record &record) {
+                if (record.is_delivered()) results.push_back(record.control_time - record.publish_time);
+            });
+            std::sort(results.begin(), results.end());
+            return results;
+        }
+
+        // Return the published messages which do not have any control message after their publish
+        // requests although the logs continue for at least stuck_after seconds. Messages are sorted by
+        // their publish time.
+        std::vector<std::pair<lifecycle::MessageId, lifecycle::Record>> stuck_messages() const {
+            std::vector<std::pair<lifecycle::MessageId, lifecycle::Record>> results;
+            auto visit = [this, &results](const lifecycle::MessageId &id, const lifecycle::Record &record) {
+                if (record.is_published() && !record.is_delivered() &&
+                    (end_time - record.publish_time >= options.stuck_after)) {
+                    results.emplace_back(id, record);
+                }
+            };
+            table.for_each(visit);
+            std::sort(results.begin(), results.end(), [](auto const &lhs, auto const &rhs) {
+                return lhs.second.publish_time < rhs.second.publish_time;
+            });
+            return results;
+        }
+
+        // Print the summary, the latency distribution of delivered messages, and the stuck messages.
+        void print() const {
+            fmt::print("Messages: {}\n", table.size());
+            fmt::print("Events: {} publish, {} control, {} error\n", nevents[lifecycle::PUBLISH],
+                       nevents[lifecycle::CONTROL], nevents[lifecycle::ERROR]);
+            if (nskipped > 0) fmt::print("Skipped headers without a valid message id: {}\n", nskipped);
+
+            const auto values = latencies();
+            fmt::print("\nDelivered messages: {}\n", values.size());
+            if (!values.empty()) {
+                auto percentile = [&values](const size_t p) {
+                    return values[(values.size() - 1) * p / 100];
+                };
+                fmt::print("Latency (seconds): min {}, p50 {}, p90 {}, p99 {}, max {}\n", values.front(),
+                           percentile(50), percentile(90), percentile(99), values.back());
+                print_histogram(values);
+            }
+
+            const auto stuck = stuck_messages();
+            fmt::print("\nStuck messages: {}\n", stuck.size());
+            for (size_t idx = 0; idx < std::min(stuck.size(), options.max_stuck); ++idx) {
+                auto const &record = stuck[idx].second;
+                fmt::print("{} published at {}, {} errors, last event at {}\n",
+                           stuck[idx].first.to_string(), timestamp::format(record.publish_time),
+                           record.counts[lifecycle::ERROR], timestamp::format(record.last_time));
+            }
+        }
+
+      private:
+        lifecycle::Options options;
+        lifecycle::FlatTable<lifecycle::Record> table;
+        size_t nevents[lifecycle::NTYPES] = {0, 0, 0};
+        size_t nskipped = 0;
+        int64_t end_time = std::numeric_limits<int64_t>::min(); // The time of the last message.
+
+        void process_header(const char *begin, const char *end, const int64_t value) {
+            const char *id = nullptr, *subject = nullptr, *level = nullptr;
+            size_t id_len = 0, subject_len = 0, level_len = 0;
+            size_t nfound = 0;
+            auto visit = [&](const char *key, const size_t key_len, const char *text, const size_t len) {
+                if (is_key(options.id_key, key, key_len)) {
+                    id = text;
+                    id_len = len;
+                } else if (is_key(options.subject_key, key, key_len)) {
+                    subject = text;
+                    subject_len = len;
+                } else if (is_key(options.level_key, key, key_len)) {
+                    level = text;
+                    level_len = len;
+                } else {
+                    return false;
+                }
+                return ++nfound == 3;
+            };
+            json::for_each_field(begin + timestamp::TIMESTAMP_LENGTH, end, visit);
+
+            lifecycle::MessageId key;
+            if ((id == nullptr) || !key.assign(id, id_len)) {
+                ++nskipped;
+                return;
+            }
+            const lifecycle::MessageType type = lifecycle::classify(subject, subject_len, level, level_len);
+            update(key, type, value);
+        }
+
+        void update(const lifecycle::MessageId &id, const lifecycle::MessageType type,
+                    const int64_t value) {
+            lifecycle::Record &record = table[id];
+            if ((type == lifecycle::PUBLISH) && !record.is_published()) record.publish_time = value;
+            if (type == lifecycle::CONTROL) record.control_time = std::max(record.control_time, value);
+            if (value >= record.last_time) {
+                record.last_time = value;
+                record.last_type = type;
+            }
+            ++record.counts[type];
+            ++nevents[type];
+            end_time = std::max(end_time, value);
+        }
+
+        static bool is_key(const std::string &name, const char *key, const size_t len) {
+            return (name.size() == len) && (memcmp(name.data(), key, len) == 0);
+        }
+
+        // Print the number of delivered messages whose latencies are in [0, 1), [1, 2), [2, 4), etc.
+        static void print_histogram(const std::vector<int64_t> &values) {
+            std::vector<size_t> buckets;
+            for (auto const value : values) {
+                size_t idx = 0;
+                while ((value >= 0) && (static_cast<uint64_t>(value) >= (1ULL << idx))) ++idx;
+                if (buckets.size() <= idx) buckets.resize(idx + 1, 0);
+                ++buckets[idx];
+            }
+            for (size_t idx = 0; idx < buckets.size(); ++idx) {
+                const uint64_t lo = (idx == 0) ? 0 : (1ULL << (idx - 1));
+                fmt::print("  [{}, {}): {}\n", lo, 1ULL << idx, buckets[idx]);
+            }
+        }
+    };
+} // namespace fastgrep
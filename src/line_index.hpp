@@ -0,0 +1,65 @@
+#pragma once
+
+#include "constants.hpp"
+#include "simd.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace fastgrep {
+    // LineIndex keeps a bitmap of all EOL positions of a buffer which is built using one SIMD pass.
+    // Policies use it to find line boundaries and to count lines with popcount instead of calling memchr
+    // for every line, which is expensive for short lines.
+    class LineIndex {
+      public:
+        void build(const char *first, const char *last) {
+            begin = first;
+            bits.resize((last - first + 63) / 64);
+            simd::bitmap(first, last, EOL, bits.data());
+        }
+
+        // Return the pointer to the first EOL in [ptr, last) or nullptr.
+        const char *next(const char *ptr) const {
+            const size_t offset = ptr - begin;
+            size_t idx = offset >> 6;
+            if (idx >= bits.size()) return nullptr;
+            uint64_t word = bits[idx] & (~0ULL << (offset & 63));
+            while (word == 0) {
+                if (++idx == bits.size()) return nullptr;
+                word = bits[idx];
+            }
+            return begin + (idx << 6) + __builtin_ctzll(word);
+        }
+
+        // Return the pointer to the last EOL in [begin, ptr) or nullptr.
+        const char *prev(const char *ptr) const {
+            const size_t offset = ptr - begin;
+            if (offset == 0) return nullptr;
+            size_t idx = (offset - 1) >> 6;
+            uint64_t word = bits[idx] & lower_bits(offset - (idx << 6));
+            while (word == 0) {
+                if (idx-- == 0) return nullptr;
+                word = bits[idx];
+            }
+            return begin + (idx << 6) + 63 - __builtin_clzll(word);
+        }
+
+        // Return the number of EOL in [first, last).
+        size_t count(const char *first, const char *last) const {
+            const size_t start = first - begin;
+            const size_t stop = last - begin;
+            if (start >= stop) return 0;
+            const size_t first_idx = start >> 6;
+            const size_t last_idx = (stop - 1) >> 6;
+            const uint64_t first_mask = ~0ULL << (start & 63);
+            const uint64_t last_mask = lower_bits(stop - (last_idx << 6));
+            return simd::popcount(bits.data() + first_idx, last_idx - first_idx + 1, first_mask, last_mask);
+        }
+
+      private:
+        const char *begin = nullptr;
+        std::vector<uint64_t> bits;
+
+        // A mask of the lowest n bits where 0 < n <= 64.
+        static uint64_t lower_bits(const size_t n) { return (n == 64) ? ~0ULL : ((1ULL << n) - 1); }
+    };
+} // namespace fastgrep
@@ -0,0 +1,309 @@
+#pragma once
+
+#include "constants.hpp"
+#include "hs/hs.h"
+#include "simd.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fastgrep {
+    namespace literals {
+        // Every match of a pattern contains one of its required literals. An empty list means that we do
+        // not know any required literal.
+        using Literals = std::vector<std::string>;
+
+        // Short literals match too many lines and it is faster to let hyperscan scan the whole buffer.
+        constexpr size_t MIN_LITERAL_SIZE = 3;
+
+        // The maximum number of literals of a pattern which has alternations.
+        constexpr size_t MAX_LITERALS = 4;
+
+        // Extract required literals from a regular expression. The analyzer only understands a common
+        // subset of the PCRE syntax and it gives up if it sees anything else such as inline flags,
+        // lookarounds, or back references.
+        class Analyzer {
+          public:
+            explicit Analyzer(const std::string &patt) : pattern(patt), pos(0) {}
+
+            Literals operator()() {
+                Literals results;
+                if (!parse_alternation(results) || (pos != pattern.size())) return Literals();
+                return results;
+            }
+
+          private:
+            enum class Atom { LITERAL, GROUP, ANCHOR, OTHER };
+
+            const std::string &pattern;
+            size_t pos;
+
+            // A list of branches is only useful if all branches have required literals.
+            bool parse_alternation(Literals &results) {
+                Literals all;
+                bool is_complete = true;
+                size_t nbranches = 0;
+                while (true) {
+                    Literals branch;
+                    if (!parse_sequence(branch)) return false;
+                    ++nbranches;
+                    if (branch.empty()) is_complete = false;
+                    all.insert(all.end(), branch.begin(), branch.end());
+                    if ((pos < pattern.size()) && (pattern[pos] == '|')) {
+                        ++pos;
+                        continue;
+                    }
+                    break;
+                }
+
+                std::sort(all.begin(), all.end());
+                all.erase(std::unique(all.begin(), all.end()), all.end());
+                const bool is_useful = is_complete && ((nbranches == 1) || (all.size() <= MAX_LITERALS));
+                results = is_useful ? all : Literals();
+                return true;
+            }
+
+            // Find the best list of required literals of a sequence of atoms.
+            bool parse_sequence(Literals &best) {
+                std::string run;
+                while ((pos < pattern.size()) && (pattern[pos] != '|') && (pattern[pos] != ')')) {
+                    char c = 0;
+                    Literals group;
+                    Atom atom;
+                    if (!parse_atom(atom, c, group)) return false;
+
+                    size_t min_count = 1;
+                    bool has_quantifier = false;
+                    if (!parse_quantifier(has_quantifier, min_count)) return false;
+
+                    if ((atom == Atom::LITERAL) && (min_count > 0)) run.push_back(c);
+                    if ((atom != Atom::LITERAL) || has_quantifier) {
+                        consider(Literals{run}, best);
+                        run.clear();
+                    }
+                    if ((atom == Atom::GROUP) && (min_count > 0)) consider(group, best);
+                }
+                consider(Literals{run}, best);
+                return true;
+            }
+
+            bool parse_atom(Atom &atom, char &c, Literals &group) {
+                c = pattern[pos++];
+                switch (c) {
+                case '(':
+                    // Plain groups and non-capturing groups are supported, other (?...) constructs are not.
+                    if ((pos < pattern.size()) && (pattern[pos] == '?')) {
+                        if ((pos + 1 >= pattern.size()) || (pattern[pos + 1] != ':')) return false;
+                        pos += 2;
+                    }
+                    if (!parse_alternation(group)) return false;
+                    if ((pos >= pattern.size()) || (pattern[pos] != ')')) return false;
+                    ++pos;
+                    atom = Atom::GROUP;
+                    return true;
+                case '[':
+                    atom = Atom::OTHER;
+                    return skip_class();
+                case '.':
+                    atom = Atom::OTHER;
+                    return true;
+                case '^':
+                case '$':
+                    atom = Atom::ANCHOR;
+                    return true;
+                case '\\':
+                    return parse_escape(atom, c);
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                    return false;
+                default:
+                    atom = Atom::LITERAL;
+                    return true;
+                }
+            }
+
+            bool parse_escape(Atom &atom, char &c) {
+                if (pos >= pattern.size()) return false;
+                c = pattern[pos++];
+                atom = Atom::LITERAL;
+                if (!isalnum(static_cast<unsigned char>(c))) return true;
+                switch (c) {
+                case 'n':
+                    c = '\n';
+                    return true;
+                case 't':
+                    c = '\t';
+                    return true;
+                case 'r':
+                    c = '\r';
+                    return true;
+                case 'f':
+                    c = '\f';
+                    return true;
+                case 'a':
+                    c = '\a';
+                    return true;
+                case 'e':
+                    c = '\x1b';
+                    return true;
+                case 'x':
+                    return parse_hex(c);
+                case 'd':
+                case 'D':
+                case 'w':
+                case 'W':
+                case 's':
+                case 'S':
+                case 'h':
+                case 'H':
+                case 'v':
+                case 'V':
+                case 'N':
+                case 'R':
+                    atom = Atom::OTHER;
+                    return true;
+                case 'b':
+                case 'B':
+                case 'A':
+                case 'z':
+                case 'Z':
+                case 'G':
+                    atom = Atom::ANCHOR;
+                    return true;
+                default:
+                    return false;
+                }
+            }
+
+            // Parse \xhh and \x{hh}.
+            bool parse_hex(char &c) {
+                const bool has_braces = (pos < pattern.size()) && (pattern[pos] == '{');
+                if (has_braces) ++pos;
+                unsigned int value = 0;
+                size_t ndigits = 0;
+                while ((pos < pattern.size()) && isxdigit(static_cast<unsigned char>(pattern[pos])) &&
+                       (has_braces || (ndigits < 2))) {
+                    const char d = static_cast<char>(tolower(pattern[pos++]));
+                    value = value * 16 + static_cast<unsigned int>(isdigit(d) ? d - '0' : d - 'a' + 10);
+                    ++ndigits;
+                }
+                if (has_braces && ((pos >= pattern.size()) || (pattern[pos++] != '}'))) return false;
+                if ((ndigits == 0) || (value > 0xff)) return false;
+                c = static_cast<char>(value);
+                return true;
+            }
+
+            // Skip a character class. A ']' right after '[' or '[^' is a part of the class.
+            bool skip_class() {
+                if ((pos < pattern.size()) && (pattern[pos] == '^')) ++pos;
+                if ((pos < pattern.size()) && (pattern[pos] == ']')) ++pos;
+                while (pos < pattern.size()) {
+                    const char c = pattern[pos++];
+                    if (c == ']') return true;
+                    if (c == '\\') {
+                        ++pos;
+                    } else if ((c == '[') && (pos < pattern.size()) && (pattern[pos] == ':')) {
+                        const size_t end = pattern.find(":]", pos + 1);
+                        if (end == std::string::npos) return false;
+                        pos = end + 2;
+                    }
+                }
+                return false;
+            }
+
+            // Parse *, +, ?, {n}, {n,}, {n,m} and their lazy or possessive versions.
+            bool parse_quantifier(bool &has_quantifier, size_t &min_count) {
+                if (pos >= pattern.size()) return true;
+                const char c = pattern[pos];
+                if ((c == '*') || (c == '?')) {
+                    min_count = 0;
+                } else if (c == '+') {
+                    min_count = 1;
+                } else if (c == '{') {
+                    size_t end = pos + 1;
+                    size_t value = 0;
+                    while ((end < pattern.size()) && isdigit(static_cast<unsigned char>(pattern[end]))) {
+                        value = value * 10 + static_cast<size_t>(pattern[end++] - '0');
+                    }
+                    if (end == pos + 1) return false;
+                    end = pattern.find('}', end);
+                    if (end == std::string::npos) return false;
+                    min_count = value;
+                    pos = end;
+                } else {
+                    return true;
+                }
+                has_quantifier = true;
+                ++pos;
+                if ((pos < pattern.size()) && ((pattern[pos] == '?') || (pattern[pos] == '+'))) ++pos;
+                return true;
+            }
+
+            // Prefer the list whose shortest literal is the longest, then the shorter list.
+            static void consider(const Literals &candidate, Literals &best) {
+                auto shortest = [](const Literals &items) {
+                    size_t results = std::string::npos;
+                    for (auto const &item : items) results = std::min(results, item.size());
+                    return items.empty() ? 0 : results;
+                };
+                const size_t len = shortest(candidate);
+                if (len == 0) return;
+                const size_t best_len = shortest(best);
+                if ((len > best_len) || ((len == best_len) && (candidate.size() < best.size()))) {
+                    best = candidate;
+                }
+            }
+        };
+
+        // Return the required literals of a pattern or an empty list if a prefilter would not help. Case
+        // insensitive patterns are not supported.
+        inline Literals required_literals(const std::string &pattern, const int mode) {
+            if (mode & HS_FLAG_CASELESS) return Literals();
+            Literals results = Analyzer(pattern)();
+            for (auto const &item : results) {
+                if ((item.size() < MIN_LITERAL_SIZE) || (item.find(EOL) != std::string::npos)) {
+                    return Literals();
+                }
+            }
+            return results;
+        }
+
+        // Find candidate lines using simd::find. Each literal is only searched before the best match so far
+        // and we start with the literal that matches first in the previous call, so a literal which
+        // does not appear in a buffer is not searched again and again until the end of the buffer.
+        class Prefilter {
+          public:
+            explicit Prefilter(Literals &&items) : literals(std::move(items)), first(0) {}
+
+            bool empty() const { return literals.empty(); }
+
+            // Return the pointer to the end of the first literal or nullptr if no literal is found.
+            const char *find(const char *begin, const char *end) {
+                const char *results = nullptr;
+                size_t winner = first;
+                for (size_t count = 0; count < literals.size(); ++count) {
+                    const size_t idx = (first + count) % literals.size();
+                    const std::string &item = literals[idx];
+                    const char *last = (results == nullptr) ? end : results - 1;
+                    if (last - begin < static_cast<ptrdiff_t>(item.size())) continue;
+                    const char *ptr = simd::find(begin, last, item.data(), item.size());
+                    if (ptr != nullptr) {
+                        results = ptr + item.size();
+                        winner = idx;
+                    }
+                }
+                first = winner;
+                return results;
+            }
+
+          private:
+            Literals literals;
+            size_t first;
+        };
+    } // namespace literals
+} // namespace fastgrep
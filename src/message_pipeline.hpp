@@ -0,0 +1,270 @@
+#pragma once
+
+#include "chunk_reader.hpp"
+#include "constants.hpp"
+#include "queue.hpp"
+#include "reader.hpp"
+#include "scheduler.hpp"
+#include "timestamp.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace fastgrep {
+    namespace pipeline {
+        // A growable buffer which does not initialize new data because it is overwritten by read anyway.
+        class Buffer {
+          public:
+            char *data() { return buffer.get(); }
+            const char *data() const { return buffer.get(); }
+            size_t size() const { return len; }
+            bool empty() const { return len == 0; }
+            char back() const { return buffer[len - 1]; }
+
+            void reserve(const size_t n) {
+                if (n <= capacity) return;
+                capacity = std::max(n, 2 * capacity);
+                std::unique_ptr<char[]> tmp(new char[capacity]);
+                if (len > 0) memcpy(tmp.get(), buffer.get(), len);
+                buffer.swap(tmp);
+            }
+
+            void resize(const size_t n) {
+                reserve(n);
+                len = n;
+            }
+
+            void assign(const char *begin, const char *end) {
+                len = 0;
+                resize(end - begin);
+                if (len > 0) memcpy(buffer.get(), begin, len);
+            }
+
+            void push_back(const char c) {
+                resize(len + 1);
+                buffer[len - 1] = c;
+            }
+
+            void swap(Buffer &other) {
+                buffer.swap(other.buffer);
+                std::swap(len, other.len);
+                std::swap(capacity, other.capacity);
+            }
+
+          private:
+            std::unique_ptr<char[]> buffer;
+            size_t len = 0;
+            size_t capacity = 0;
+        };
+
+        // A chunk of complete messages and its position in the file.
+        struct Chunk {
+            size_t index = 0;
+            Buffer data;
+        };
+
+        // Return the beginning of the last message of [begin, end), i.e the last line which starts with a
+        // timestamp, or nullptr if the only message starts at begin. A message spans all lines up to the
+        // next header so the data before the returned position can be processed on its own.
+        inline const char *last_message(const char *begin, const char *end) {
+            const char *eol = end;
+            while (eol > begin) {
+                eol = static_cast<const char *>(memrchr(begin, EOL, eol - begin));
+                if (eol == nullptr) return nullptr;
+                int64_t value;
+                if (timestamp::parse(eol + 1, end, value)) return eol + 1;
+            }
+            return nullptr;
+        }
+
+        // Return the end of the last complete line of [begin, end) or nullptr if there is no EOL.
+        inline const char *last_line(const char *begin, const char *end) {
+            const char *eol = static_cast<const char *>(memrchr(begin, EOL, end - begin));
+            return (eol == nullptr) ? nullptr : eol + 1;
+        }
+    } // namespace pipeline
+
+    // Search a chunk of complete lines using the filters of FileReader. Chunks must start at the beginning
+    // of a message because the lines before the first header of a chunk are rejected by header
+    // constraints. A chunk is passed to the policy in blocks like RangeSearch does.
+    template <typename Policy> class ChunkSearch : public FileReader<Policy> {
+      public:
+        template <typename... Args>
+        ChunkSearch(Args &&... args) : FileReader<Policy>(std::forward<Args>(args)...) {}
+
+        void operator()(const char *fname, const char *begin, const char *end) {
+            this->start_file(fname);
+            auto process = [this](const char *block, const size_t len) { this->process_lines(block, len); };
+            for_each_block(begin, end, process, [this]() { return Policy::is_done(); });
+            Policy::finalize();
+        }
+    };
+
+    // Search a big log file using a pipeline of threads. A reader thread reads the file sequentially and
+    // cuts the read data into chunks which end at a message boundary, or at EOL if messages are not
+    // required. Chunks are pushed into a bounded queue and a pool of workers search them. The output of
+    // the workers is given to a sink in the file order by the calling thread so the results are the same
+    // as those of a single threaded search.
+    //
+    // The number of chunks in the pipeline, i.e read but not written by the sink, is bounded so the
+    // memory usage does not depend on the file size even if the sink is slower than the workers. Line
+    // numbers are not computed.
+    template <typename Worker> class MessagePipeline {
+      public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 21;
+
+        MessagePipeline(const size_t threads, const bool by_message = true,
+                        const size_t chunk = DEFAULT_CHUNK_SIZE)
+            : nthreads(std::max<size_t>(threads, 1)), split_messages(by_message),
+              chunk_size(std::max<size_t>(chunk, 1)), max_chunks(4 * nthreads) {}
+
+        // Search a file. Each worker is constructed using args and is configured by setup. The sink gets
+        // the output of each chunk in the file order. Return the number of matches. A read error stops the
+        // pipeline and it is thrown after the chunks read before it have been given to the sink.
+        template <typename Setup, typename Sink, typename... Args>
+        size_t operator()(const char *datafile, Setup &&setup, Sink &&sink, const Args &... args) {
+            int fd = ::open(datafile, O_RDONLY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open file: %s\n", datafile);
+                return 0;
+            }
+
+            BoundedQueue<pipeline::Chunk> tasks(max_chunks);
+            OrderedOutput output;
+            written = 0;
+            int error = 0;
+            std::thread producer([this, fd, &tasks, &output, &error]() {
+                const size_t nchunks = read(fd, tasks, error);
+                tasks.close();
+                output.close(nchunks);
+            });
+
+            Scheduler<pipeline::Chunk> scheduler(nthreads, tasks);
+            std::atomic<size_t> matches(0);
+            auto worker_fn = [datafile, &setup, &scheduler, &output, &matches, &args...](const size_t id) {
+                Worker worker(args...);
+                setup(worker);
+                pipeline::Chunk chunk;
+                while (scheduler.next(id, chunk)) {
+                    worker(datafile, chunk.data.data(), chunk.data.data() + chunk.data.size());
+                    auto &console = worker.get_console();
+                    output.set(chunk.index, std::move(console.buffer));
+                    console.buffer.clear();
+                }
+                matches += worker.number_of_matches();
+            };
+            scheduler.start(worker_fn);
+
+            output.write([this, &sink](const std::string &data) {
+                sink(data);
+                release();
+            });
+            scheduler.join();
+            producer.join();
+            ::close(fd);
+            if (error != 0) {
+                throw std::runtime_error(std::string("Cannot read from file: ") + datafile + ": " +
+                                         strerror(error));
+            }
+            return matches;
+        }
+
+      private:
+        size_t nthreads;
+        bool split_messages;
+        size_t chunk_size;
+        size_t max_chunks;
+
+        // The number of chunks written by the sink. The reader waits until a chunk has been written
+        // before reading more than max_chunks ahead.
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t written = 0;
+
+        void release() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++written;
+            }
+            cv.notify_one();
+        }
+
+        void acquire(const size_t index) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this, index] { return index < written + max_chunks; });
+        }
+
+        // Read a file and push its chunks into the queue. Return the number of chunks. The data after the
+        // last boundary of a chunk is moved to the next one, and a chunk grows until it has a boundary.
+        // Only the new data and the last line of the old data are searched for a boundary when a chunk
+        // grows so a huge message is scanned once. The errno of a read error is stored in error.
+        size_t read(const int fd, BoundedQueue<pipeline::Chunk> &tasks, int &error) {
+            pipeline::Buffer leftover;
+            size_t scanned = 0; // The leftover data before this position does not have a boundary.
+            size_t index = 0;
+            off_t offset = 0;
+            while (true) {
+                pipeline::Chunk chunk;
+                chunk.data.swap(leftover);
+                const size_t pos = chunk.data.size();
+                chunk.data.resize(pos + chunk_size);
+                ssize_t nbytes;
+                do {
+                    nbytes = ::pread(fd, chunk.data.data() + pos, chunk_size, offset);
+                } while ((nbytes < 0) && (errno == EINTR));
+                if (nbytes < 0) {
+                    error = errno;
+                    break;
+                }
+                chunk.data.resize(pos + nbytes);
+                offset += nbytes;
+
+                if (nbytes == 0) {
+                    if (chunk.data.empty()) break;
+                    if (chunk.data.back() != EOL) chunk.data.push_back(EOL);
+                } else {
+                    const char *begin = chunk.data.data();
+                    const char *end = begin + chunk.data.size();
+                    const char *from = begin + scanned;
+                    const char *boundary = split_messages ? pipeline::last_message(from, end)
+                                                          : pipeline::last_line(from, end);
+                    if (boundary == nullptr) {
+                        // The last line might be incomplete so it is checked again.
+                        const char *last = pipeline::last_line(from, end);
+                        if (last != nullptr) {
+                            scanned = last - 1 - begin;
+                        } else if (!split_messages) {
+                            scanned = chunk.data.size();
+                        }
+                        leftover.swap(chunk.data);
+                        continue;
+                    }
+                    scanned = 0;
+                    leftover.reserve(end - boundary + chunk_size);
+                    leftover.assign(boundary, end);
+                    chunk.data.resize(boundary - begin);
+                }
+
+                acquire(index);
+                chunk.index = index;
+                const bool is_last = (nbytes == 0);
+                if (!tasks.push(std::move(chunk))) break;
+                ++index;
+                if (is_last) break;
+            }
+            return index;
+        }
+    };
+} // namespace fastgrep
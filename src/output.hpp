@@ -1,11 +1,19 @@
 #pragma once
 
 #include "fmt/format.h"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
 
 namespace fastgrep {
     struct FMTPolicy {
+        void print_filename(const char *fname) { fmt::print("{}:", fname); }
+        void print_color_filename(const char *fname) { fmt::print("\033[1;34m{}:", fname); }
+
         void print_color_text(const char *begin, const char *end, const size_t linenum) {
             fmt::print("\033[1;39m{0}:\033[1;32m{1}\033[0m\n", linenum, std::string(begin, end - begin));
         }
@@ -20,29 +28,45 @@ namespace fastgrep {
         void print_plain_text(const char *begin, const char *end) {
             fmt::print("{0}\n", std::string(begin, end - begin));
         }
+
+        void flush() {}
     };
 
+    // Write matched lines to the STDOUT using one writev call per line.
     struct DirectPolicy {
+        void print_filename(const char *fname) { fmt::print("{}:", fname); }
+        void print_color_filename(const char *fname) { fmt::print("\033[1;34m{}:", fname); }
+
         void print_color_text(const char *begin, const char *end, const size_t linenum) {
-            // TODO: using write v for this task.
-            fmt::print("\033[1;32m{0}:\033[1;39m{1}\033[0m\n", std::string(begin, end - begin), linenum);
+            fmt::print("\033[1;39m{0}:\033[1;32m{1}\033[0m\n", linenum, std::string(begin, end - begin));
         }
 
-        void print_plain_text(const char *begin, const char *end, const size_t) {
-            // TODO: using write v for this task.
-            ::write(STDIN_FILENO, begin, end - begin);
+        void print_plain_text(const char *begin, const char *end, const size_t linenum) {
+            fmt::format_int str(linenum);
+            struct iovec iov[4] = {{const_cast<char *>(str.data()), str.size()},
+                                   {const_cast<char *>(":"), 1},
+                                   {const_cast<char *>(begin), static_cast<size_t>(end - begin)},
+                                   {const_cast<char *>("\n"), 1}};
+            ::writev(STDOUT_FILENO, iov, 4);
         }
+
         void print_color_text(const char *begin, const char *end) {
-            // TODO: using write v for this task.
             fmt::print("\033[1;32m{0}\033[0m\n", std::string(begin, end - begin));
         }
 
         void print_plain_text(const char *begin, const char *end) {
-            ::write(STDIN_FILENO, begin, end - begin);
+            struct iovec iov[2] = {{const_cast<char *>(begin), static_cast<size_t>(end - begin)},
+                                   {const_cast<char *>("\n"), 1}};
+            ::writev(STDOUT_FILENO, iov, 2);
         }
+
+        void flush() {}
     };
 
     struct StorePolicy {
+        void print_filename(const char *) {}
+        void print_color_filename(const char *) {}
+
         void print_color_text(const char *begin, const char *end, const size_t linenum) {
             lines.emplace_back(std::string(begin, end - begin));
             linenums.push_back(linenum);
@@ -60,7 +84,161 @@ namespace fastgrep {
             lines.emplace_back(std::string(begin, end - begin));
         }
 
+        void flush() {}
+
         std::vector<std::string> lines{};
         std::vector<size_t> linenums;
     };
+
+    // Write the search results to a string buffer instead of the STDOUT. This policy is used by the parallel
+    // search which needs to display the search results in a deterministic order.
+    struct StringPolicy {
+        void print_filename(const char *fname) {
+            buffer.append(fname);
+            buffer.push_back(':');
+        }
+
+        void print_color_filename(const char *fname) {
+            buffer.append("\033[1;34m");
+            print_filename(fname);
+        }
+
+        void print_color_text(const char *begin, const char *end, const size_t linenum) {
+            buffer.append(fmt::format("\033[1;39m{0}:\033[1;32m", linenum));
+            print_color_text(begin, end);
+        }
+
+        void print_plain_text(const char *begin, const char *end, const size_t linenum) {
+            buffer.append(fmt::format("{0}:", linenum));
+            print_plain_text(begin, end);
+        }
+
+        void print_color_text(const char *begin, const char *end) {
+            buffer.append("\033[1;32m");
+            buffer.append(begin, end - begin);
+            buffer.append("\033[0m\n");
+        }
+
+        void print_plain_text(const char *begin, const char *end) {
+            buffer.append(begin, end - begin);
+            buffer.push_back('\n');
+        }
+
+        void flush() {}
+
+        std::string buffer;
+    };
+
+    // Collect the search results as a list of iovec which point directly to the read buffer and write them
+    // to the STDOUT using a single writev call. Policies must call flush before the read buffer or the line
+    // buffer is reused. Small prefixes such as line numbers are copied to an internal buffer.
+    class WritevPolicy {
+      public:
+        static constexpr size_t MAX_IOVECS = 1024; // IOV_MAX on Linux
+        static constexpr size_t PREFIX_BUFFER_SIZE = 1 << 14;
+        static constexpr size_t MAX_PREFIX_SIZE = 32;
+
+        WritevPolicy() : iovecs(), prefix(new char[PREFIX_BUFFER_SIZE]), prefix_size(0) {
+            iovecs.reserve(MAX_IOVECS);
+        }
+
+        WritevPolicy(const WritevPolicy &) = delete;
+        WritevPolicy &operator=(const WritevPolicy &) = delete;
+
+        ~WritevPolicy() { flush(); }
+
+        void print_filename(const char *fname) {
+            reserve();
+            add(fname, strlen(fname));
+            add(":", 1);
+        }
+
+        void print_color_filename(const char *fname) {
+            reserve();
+            add("\033[1;34m", 7);
+            add(fname, strlen(fname));
+            add(":", 1);
+        }
+
+        void print_color_text(const char *begin, const char *end, const size_t linenum) {
+            reserve();
+            add("\033[1;39m", 7);
+            add_linenum(linenum);
+            add(":\033[1;32m", 8);
+            add(begin, end - begin);
+            add("\033[0m\n", 5);
+        }
+
+        void print_plain_text(const char *begin, const char *end, const size_t linenum) {
+            reserve();
+            add_linenum(linenum);
+            add(":", 1);
+            add(begin, end - begin);
+            add("\n", 1);
+        }
+
+        void print_color_text(const char *begin, const char *end) {
+            reserve();
+            add("\033[1;32m", 7);
+            add(begin, end - begin);
+            add("\033[0m\n", 5);
+        }
+
+        void print_plain_text(const char *begin, const char *end) {
+            reserve();
+            add(begin, end - begin);
+            add("\n", 1);
+        }
+
+        // Write all collected data to the STDOUT.
+        void flush() {
+            struct iovec *iov = iovecs.data();
+            int count = static_cast<int>(iovecs.size());
+            while (count > 0) {
+                ssize_t nbytes = ::writev(STDOUT_FILENO, iov, count);
+                if (nbytes < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+
+                // Skip all iovecs which have been written.
+                while ((count > 0) && (static_cast<size_t>(nbytes) >= iov->iov_len)) {
+                    nbytes -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+
+                if (count > 0) {
+                    iov->iov_base = static_cast<char *>(iov->iov_base) + nbytes;
+                    iov->iov_len -= nbytes;
+                }
+            }
+            iovecs.clear();
+            prefix_size = 0;
+        }
+
+      private:
+        std::vector<struct iovec> iovecs;
+        std::unique_ptr<char[]> prefix;
+        size_t prefix_size;
+
+        // Make sure that we have enough space for a line so add will not invalidate any pointer.
+        void reserve() {
+            const bool is_full = (iovecs.size() + 8 > MAX_IOVECS) ||
+                                 (prefix_size + MAX_PREFIX_SIZE > PREFIX_BUFFER_SIZE);
+            if (is_full) flush();
+        }
+
+        void add(const char *begin, const size_t len) {
+            iovecs.push_back({const_cast<char *>(begin), len});
+        }
+
+        void add_linenum(const size_t linenum) {
+            fmt::format_int str(linenum);
+            char *begin = prefix.get() + prefix_size;
+            memcpy(begin, str.data(), str.size());
+            prefix_size += str.size();
+            add(begin, str.size());
+        }
+    };
 } // namespace fastgrep
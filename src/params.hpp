@@ -15,11 +15,17 @@ namespace fastgrep {
         STDIN = 1 << 9,
         RECURSIVE = 1 << 10,
         QUITE = 1 << 11,
+        FILES_WITH_MATCHES = 1 << 12,
+        COUNT = 1 << 13,
+        SHOW_PATTERN = 1 << 14,
     };
 
     struct Params {
         int info = 0;
         int regex_mode = 0;
+        size_t max_count = 0;      // Stop searching a file after max_count matched lines. 0 means no limit.
+        size_t before_context = 0; // The number of lines printed before each matched line.
+        size_t after_context = 0;  // The number of lines printed after each matched line.
         bool verbose() const { return (info & VERBOSE) > 0; }
         bool color() const { return (info & COLOR) > 0; }
         bool use_memmap() const { return (info & USE_MEMMAP) > 0; }
@@ -28,9 +34,13 @@ namespace fastgrep {
         bool linenum() const { return (info & LINENUM) > 0; }
         bool stdin() const { return (info & STDIN) > 0; }
         bool recursive() const { return (info & RECURSIVE) > 0; }
+        bool quite() const { return (info & QUITE) > 0; }
+        bool files_with_matches() const { return (info & FILES_WITH_MATCHES) > 0; }
+        bool count() const { return (info & COUNT) > 0; }
+        bool show_pattern() const { return (info & SHOW_PATTERN) > 0; }
+        bool context() const { return (before_context + after_context) > 0; }
 
         // Unused methods
-        bool quite() const { return (info & QUITE) > 0; }
         bool utf8() const { return (info & UTF8) > 0; }
         bool utf16() const { return (info & UTF16) > 0; }
         bool utf32() const { return (info & UTF32) > 0; }
@@ -45,6 +55,13 @@ namespace fastgrep {
             fmt::print("regex_mode: {}\n", regex_mode);
             fmt::print("linenum: {}\n", linenum());
             fmt::print("recursive: {}\n", recursive());
+            fmt::print("quite: {}\n", quite());
+            fmt::print("files_with_matches: {}\n", files_with_matches());
+            fmt::print("max_count: {}\n", max_count);
+            fmt::print("count: {}\n", count());
+            fmt::print("show_pattern: {}\n", show_pattern());
+            fmt::print("before_context: {}\n", before_context);
+            fmt::print("after_context: {}\n", after_context);
 
             fmt::print("utf8: {}\n", utf8());
             fmt::print("utf16: {}\n", utf16());
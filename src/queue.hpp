@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace fastgrep {
+    // Threads which wait for a queue to have data or free slots sleep on a condition variable instead of
+    // spinning. The lock-free paths of a queue only pay for a fence and a load of the number of waiting
+    // threads. A waiting thread checks its condition again under the lock after it has registered itself
+    // and the fences guarantee that either this check sees the change or the notifier sees the waiting
+    // thread, so a notification is never lost.
+    class Waiters {
+      public:
+        // Block until the given predicate, which is evaluated under the lock, returns true.
+        template <typename Predicate> void wait(Predicate &&pred) {
+            std::unique_lock<std::mutex> lock(mutex);
+            nwaiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cv.wait(lock, pred);
+            nwaiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // Wake up one waiting thread, or all of them if the state will not change anymore.
+        void notify(const bool all = false) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (nwaiters.load(std::memory_order_relaxed) == 0) return;
+            { std::lock_guard<std::mutex> lock(mutex); }
+            if (all) {
+                cv.notify_all();
+            } else {
+                cv.notify_one();
+            }
+        }
+
+      private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<size_t> nwaiters{0};
+    };
+
+    // A bounded multi-producer multi-consumer lock-free queue. The algorithm is based on Dmitry Vyukov's
+    // bounded MPMC queue. The capacity of the queue is rounded up to a power of two.
+    template <typename T> class BoundedQueue {
+      public:
+        explicit BoundedQueue(const size_t capacity)
+            : size(round_up(capacity)), mask(size - 1), cells(new Cell[size]), enqueue_pos(0),
+              dequeue_pos(0), closed(false) {
+            for (size_t idx = 0; idx < size; ++idx) {
+                cells[idx].sequence.store(idx, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue &) = delete;
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        // Return false if the queue is full.
+        bool try_push(T &&data) {
+            if (!push_data(data)) return false;
+            not_empty.notify();
+            return true;
+        }
+
+        // Return false if the queue is empty.
+        bool try_pop(T &data) {
+            if (!pop_data(data)) return false;
+            not_full.notify();
+            return true;
+        }
+
+        // Wait until there is a free slot in the queue. Return false if consumers have closed the queue.
+        bool push(T &&data) {
+            bool pushed = push_data(data);
+            if (!pushed) {
+                not_full.wait([this, &data, &pushed] { return (pushed = push_data(data)) || is_closed(); });
+            }
+            if (pushed) not_empty.notify();
+            return pushed;
+        }
+
+        // Wait until we have data or the queue is closed. Return false if there is no more data.
+        bool pop(T &data) {
+            bool popped = pop_data(data);
+            if (!popped) {
+                not_empty.wait([this, &data, &popped] { return (popped = pop_data(data)) || is_closed(); });
+            }
+            if (popped || pop_data(data)) {
+                not_full.notify();
+                return true;
+            }
+            return false;
+        }
+
+        // Wait until the queue might have data or it is closed.
+        void wait() { not_empty.wait([this] { return has_data() || is_closed(); }); }
+
+        // Producers call this method to tell consumers that there is no more data. Consumers can also call
+        // this method to tell producers that they do not need more data.
+        void close() {
+            closed.store(true, std::memory_order_release);
+            not_empty.notify(true);
+            not_full.notify(true);
+        }
+
+        bool is_closed() const { return closed.load(std::memory_order_acquire); }
+
+      private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        bool push_data(T &data) {
+            Cell *cell;
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = std::move(data);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop_data(T &data) {
+            Cell *cell;
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            data = std::move(cell->data);
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Return true if the cell at the dequeue position has data or it has been taken already so
+        // try_pop should be called again.
+        bool has_data() const {
+            const size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            const size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+            return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) >= 0;
+        }
+
+        static size_t round_up(const size_t capacity) {
+            size_t results = 2;
+            while (results < capacity) results <<= 1;
+            return results;
+        }
+
+        const size_t size;
+        const size_t mask;
+        std::unique_ptr<Cell[]> cells;
+        alignas(64) std::atomic<size_t> enqueue_pos;
+        alignas(64) std::atomic<size_t> dequeue_pos;
+        alignas(64) std::atomic<bool> closed;
+        Waiters not_empty;
+        Waiters not_full;
+    };
+
+    // A bounded single-producer single-consumer lock-free queue. The producer only writes the tail and the
+    // consumer only writes the head so we do not need compare-and-swap loops.
+    template <typename T> class SPSCQueue {
+      public:
+        explicit SPSCQueue(const size_t capacity)
+            : size(round_up(capacity)), mask(size - 1), cells(new T[size]), head(0), tail(0),
+              closed(false) {}
+
+        SPSCQueue(const SPSCQueue &) = delete;
+        SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+        // Return false if the queue is full.
+        bool try_push(T &&data) {
+            if (!push_data(data)) return false;
+            not_empty.notify();
+            return true;
+        }
+
+        // Return false if the queue is empty.
+        bool try_pop(T &data) {
+            if (!pop_data(data)) return false;
+            not_full.notify();
+            return true;
+        }
+
+        // Wait until there is a free slot in the queue. Return false if the consumer has closed the
+        // queue.
+        bool push(T &&data) {
+            bool pushed = push_data(data);
+            if (!pushed) {
+                not_full.wait([this, &data, &pushed] { return (pushed = push_data(data)) || is_closed(); });
+            }
+            if (pushed) not_empty.notify();
+            return pushed;
+        }
+
+        // Wait until we have data or the queue is closed. Return false if there is no more data.
+        bool pop(T &data) {
+            bool popped = pop_data(data);
+            if (!popped) {
+                not_empty.wait([this, &data, &popped] { return (popped = pop_data(data)) || is_closed(); });
+            }
+            if (popped || pop_data(data)) {
+                not_full.notify();
+                return true;
+            }
+            return false;
+        }
+
+        void close() {
+            closed.store(true, std::memory_order_release);
+            not_empty.notify(true);
+            not_full.notify(true);
+        }
+
+        bool is_closed() const { return closed.load(std::memory_order_acquire); }
+
+      private:
+        bool push_data(T &data) {
+            const size_t pos = tail.load(std::memory_order_relaxed);
+            if (pos - head.load(std::memory_order_acquire) == size) return false;
+            cells[pos & mask] = std::move(data);
+            tail.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop_data(T &data) {
+            const size_t pos = head.load(std::memory_order_relaxed);
+            if (pos == tail.load(std::memory_order_acquire)) return false;
+            data = std::move(cells[pos & mask]);
+            head.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        static size_t round_up(const size_t capacity) {
+            size_t results = 2;
+            while (results < capacity) results <<= 1;
+            return results;
+        }
+
+        const size_t size;
+        const size_t mask;
+        std::unique_ptr<T[]> cells;
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+        alignas(64) std::atomic<bool> closed;
+        Waiters not_empty;
+        Waiters not_full;
+    };
+} // namespace fastgrep
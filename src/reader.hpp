@@ -0,0 +1,535 @@
+#pragma once
+
+#include "constants.hpp"
+#include "field_filter.hpp"
+#include "header_filter.hpp"
+#include "io_strategy.hpp"
+#include "queue.hpp"
+#include "sidecar.hpp"
+#include "time_range.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace fastgrep {
+    // A page aligned buffer which can be used with O_DIRECT reads. The content is kept when the buffer
+    // grows.
+    class AlignedBuffer {
+      public:
+        static constexpr size_t ALIGNMENT = 4096;
+
+        char *data() { return ptr.get(); }
+        size_t size() const { return len; }
+
+        void resize(const size_t size) {
+            void *new_ptr = nullptr;
+            if (posix_memalign(&new_ptr, ALIGNMENT, size) != 0) throw std::bad_alloc();
+            if (len > 0) memcpy(new_ptr, ptr.get(), std::min(len, size));
+            ptr.reset(static_cast<char *>(new_ptr));
+            len = size;
+        }
+
+      private:
+        struct Deleter {
+            void operator()(char *p) const { free(p); }
+        };
+        std::unique_ptr<char, Deleter> ptr;
+        size_t len = 0;
+    };
+
+    // The blocks shared by a reader and its I/O thread. Empty blocks are sent to the I/O thread and filled
+    // blocks are sent back in the read order. Data is read after the first headroom bytes of a block so the
+    // reader can move the unfinished line of the previous block in front of it.
+    struct ReadAheadBuffers {
+        struct Block {
+            size_t index = 0;
+            size_t offset = 0; // The position of the read data.
+            ssize_t size = 0;  // The number of read bytes, 0 at the end of file, and -1 if the read fails.
+            int error = 0;
+        };
+
+        ReadAheadBuffers(const size_t nblocks, const size_t nbytes)
+            : blocks(nblocks), block_size(nbytes), headroom(1 << 12), empty_blocks(nblocks),
+              filled_blocks(nblocks) {}
+
+        std::vector<std::vector<char>> blocks;
+        size_t block_size;
+
+        // The reader increases it if a line does not fit into the headroom of a block.
+        std::atomic<size_t> headroom;
+
+        SPSCQueue<size_t> empty_blocks;
+        SPSCQueue<Block> filled_blocks;
+    };
+
+    // Policies which can be told that a number of lines are skipped support sidecar indexes.
+    template <typename T, typename = void> struct can_skip_lines : std::false_type {};
+    template <typename T>
+    struct can_skip_lines<T, decltype(std::declval<T &>().skip_lines(size_t()), void())>
+        : std::true_type {};
+
+    // These readers have the same interface as those in ioutils, however, they will stop reading data as
+    // soon as the policy does not need more data i.e policy's is_done method returns true. Policies must
+    // reset their per-file states in set_filename. The finalize method is always called so policies can
+    // report per-file results.
+    //
+    // Policies only get complete lines. The unfinished line at the end of a read is moved to the front of
+    // the buffer and the next read appends data to it, so a line is always contiguous in one buffer and
+    // policies never need to copy it. The buffer grows geometrically if a line does not fit into it. The
+    // last line of a file gets an EOL if it does not have one.
+    //
+    // FileReader selects the I/O method of each file using select_io_strategy unless users force one
+    // using set_io_method. If a sidecar query is set then files which have an up to date sidecar index are
+    // searched block by block and the blocks that cannot match are skipped. If a time window is set then
+    // files must be sorted by time and only the lines in the window are read. If header constraints are
+    // set then policies only get the lines of the messages whose headers are accepted, and if field
+    // constraints are set then policies only get the lines whose JSON payloads satisfy them.
+    template <typename Policy> class FileReader : public Policy {
+      public:
+        template <typename... Args> FileReader(Args &&... args) : Policy(std::forward<Args>(args)...) {}
+
+        void operator()(const char *datafile) {
+            int fd = ::open(datafile, O_RDONLY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open file: %s\n", datafile);
+                return;
+            }
+            search(fd, datafile);
+            ::close(fd);
+        }
+
+        // Set the number of bytes requested by each read call.
+        void set_buffer_size(const size_t size) { read_size = std::max<size_t>(size, 1); }
+
+        // Use the given I/O method for all files instead of selecting one per file.
+        void set_io_method(const IOMethod value) {
+            adaptive = false;
+            method = value;
+        }
+
+        // Use sidecar indexes with the given query. This is ignored if the policy cannot skip lines.
+        void set_index_query(sidecar::Query &&value) {
+            query = std::move(value);
+            use_index = true;
+        }
+
+        // Only search the messages whose headers satisfy the given constraints.
+        void set_header_constraints(const HeaderConstraints &value) { header = value; }
+
+        // Only search the lines whose JSON fields satisfy the given constraints.
+        void set_field_constraints(const FieldConstraints &value) { fields = value; }
+
+        // Only search the lines whose timestamps are in [begin, end].
+        void set_time_range(const int64_t begin, const int64_t end) {
+            begin_time = begin;
+            end_time = end;
+            use_time_range = true;
+        }
+
+      protected:
+        AlignedBuffer buffer;
+        size_t read_size = io::DEFAULT_BUFFER_SIZE;
+        bool adaptive = true;
+        IOMethod method = IOMethod::READ;
+        bool use_index = false;
+        sidecar::Query query;
+        bool use_time_range = false;
+        int64_t begin_time = 0;
+        int64_t end_time = 0;
+        HeaderConstraints header;
+        FieldConstraints fields;
+
+        void start_file(const char *datafile) {
+            header.reset();
+            Policy::set_filename(datafile);
+        }
+
+        // Pass complete lines to the policy. Lines of rejected messages are dropped.
+        void process_lines(const char *begin, const size_t len) {
+            if (header.empty()) {
+                process_fields(begin, len);
+                return;
+            }
+            header.filter(begin, begin + len, [this](const char *run, const size_t size) {
+                if (!Policy::is_done()) process_fields(run, size);
+            });
+        }
+
+        // Pass complete lines to the policy. Lines whose JSON fields are rejected are dropped.
+        void process_fields(const char *begin, const size_t len) {
+            if (fields.empty()) {
+                Policy::process(begin, len);
+                return;
+            }
+            fields.filter(begin, begin + len, [this](const char *run, const size_t size) {
+                if (!Policy::is_done()) Policy::process(run, size);
+            });
+        }
+
+        // Search an opened file from its beginning.
+        void search(const int fd, const char *datafile) {
+            struct stat info;
+            if (fstat(fd, &info) < 0) {
+                fprintf(stderr, "Cannot get the status of file: %s\n", datafile);
+                return;
+            }
+            // Time windows do not use sidecar indexes because the binary search only reads a few pages
+            // while the bloom filters of a big file are a few percent of its size.
+            if (use_time_range) {
+                search_time_range(fd, info, datafile);
+                return;
+            }
+            // Skipped blocks are reported to the policy as non-matching lines so they cannot be used
+            // with header or field constraints.
+            const bool can_use_index = use_index && header.empty() && fields.empty();
+            if (can_use_index && search_indexed(fd, info, datafile, can_skip_lines<Policy>())) return;
+
+            IOStrategy strategy;
+            if (adaptive) {
+                strategy = select_io_strategy(fd, info, read_size);
+            } else {
+                strategy.method = method;
+                strategy.buffer_size = read_size;
+            }
+
+            start_file(datafile);
+            switch (strategy.method) {
+            case IOMethod::MMAP:
+                read_mmap(fd, info.st_size, strategy.willneed);
+                break;
+            case IOMethod::DIRECT:
+                read_direct(fd, strategy.buffer_size);
+                break;
+            case IOMethod::READ_AHEAD:
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                read_ahead(fd, strategy.buffer_size);
+                break;
+            default:
+                // Let the kernel know that we will read the file sequentially.
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                read(fd, strategy.buffer_size);
+            }
+        }
+
+        // Search the blocks of a file that may match using its sidecar index. Return false if the file
+        // does not have an up to date index.
+        bool search_indexed(const int fd, const struct stat &info, const char *datafile, std::true_type) {
+            sidecar::Index index;
+            if (!S_ISREG(info.st_mode) || !index.load(sidecar::path(datafile), info)) return false;
+
+            start_file(datafile);
+            size_t line = 0;
+            for (size_t idx = 0; (idx < index.size()) && !Policy::is_done(); ++idx) {
+                if (!query.may_match(index, idx)) continue;
+                const sidecar::Block &block = index.block(idx);
+                const size_t len = index.end_offset(idx) - block.offset;
+                if (len == 0) continue;
+                if (buffer.size() < len + 1) buffer.resize(len + 1);
+                char *data = buffer.data();
+                if (!pread_all(fd, data, len, block.offset)) {
+                    perror("pread");
+                    break;
+                }
+
+                // Only the last block might not end with EOL.
+                const size_t size = (data[len - 1] == EOL) ? len : len + 1;
+                data[len] = EOL;
+                Policy::skip_lines(block.line - line);
+                process_lines(data, size);
+                line = block.line + index.lines(idx);
+            }
+            if (!Policy::is_done()) Policy::skip_lines(index.number_of_lines() - line);
+            Policy::finalize();
+            return true;
+        }
+
+        bool search_indexed(const int, const struct stat &, const char *, std::false_type) { return false; }
+
+        // Binary search a file for the lines in the time window then read them using pread. Files which
+        // cannot be seeked are not searched.
+        void search_time_range(const int fd, const struct stat &info, const char *datafile) {
+            if (!S_ISREG(info.st_mode)) {
+                fprintf(stderr, "Cannot search the time window of a non-regular file: %s\n", datafile);
+                return;
+            }
+            const TimeRange range = find_time_range(fd, info.st_size, begin_time, end_time);
+            start_file(datafile);
+            size_t tail = 0; // The unfinished line is kept at the front of the buffer.
+            for (size_t offset = range.begin; (offset < range.end) && !Policy::is_done();) {
+                const size_t len = std::min(read_size, range.end - offset);
+                const size_t required = tail + len + 1; // Leave room for the EOL of the last line.
+                if (buffer.size() < required) buffer.resize(std::max(required, 2 * buffer.size()));
+                char *data = buffer.data();
+                if (!pread_all(fd, data + tail, len, offset)) {
+                    perror("pread");
+                    tail = 0;
+                    break;
+                }
+                offset += len;
+
+                const char *last = static_cast<const char *>(memrchr(data + tail, EOL, len));
+                const size_t size = tail + len;
+                tail = size;
+                if (last != nullptr) {
+                    process_lines(data, last - data + 1);
+                    tail = data + size - (last + 1);
+                    if (tail > 0) memmove(data, last + 1, tail);
+                }
+            }
+            if ((tail > 0) && !Policy::is_done()) {
+                buffer.data()[tail] = EOL;
+                process_lines(buffer.data(), tail + 1);
+            }
+            Policy::finalize();
+        }
+
+        static bool pread_all(const int fd, char *data, size_t len, off_t offset) {
+            while (len > 0) {
+                const ssize_t nbytes = ::pread(fd, data, len, offset);
+                if (nbytes < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                if (nbytes == 0) {
+                    errno = EIO; // The file is truncated after its index has been checked.
+                    return false;
+                }
+                data += nbytes;
+                offset += nbytes;
+                len -= nbytes;
+            }
+            return true;
+        }
+
+        // Read a file using the read system call. The tail of the previous read is kept right before an
+        // aligned offset so the buffer address of every read is aligned, which is required by O_DIRECT.
+        void read(const int fd, const size_t nbytes_per_read, size_t alignment = 1) {
+            size_t tail = 0;
+            while (true) {
+                // Make sure that we can read nbytes_per_read bytes and there is room for the EOL of the
+                // last line.
+                const size_t offset = (tail + alignment - 1) / alignment * alignment;
+                const size_t required = offset + nbytes_per_read + 1;
+                if (buffer.size() < required) { buffer.resize(std::max(required, 2 * buffer.size())); }
+
+                char *data = buffer.data();
+                const ssize_t nbytes = ::read(fd, data + offset, nbytes_per_read);
+                if (nbytes < 0) {
+                    if (errno == EINTR) continue;
+
+                    // Some file systems accept the O_DIRECT flag but reject the reads so use buffered reads
+                    // instead.
+                    if ((errno == EINVAL) && (alignment > 1)) {
+                        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                        if (tail > 0) memmove(data, data + offset - tail, tail);
+                        alignment = 1;
+                        continue;
+                    }
+                    perror("read");
+                    break;
+                }
+
+                char *begin = data + offset - tail;
+                if (nbytes == 0) {
+                    if (tail > 0) {
+                        data[offset] = EOL;
+                        process_lines(begin, tail + 1);
+                    }
+                    break;
+                }
+
+                const size_t len = tail + nbytes;
+                const char *last = static_cast<const char *>(memrchr(data + offset, EOL, nbytes));
+                const char *rest = begin;
+                if (last != nullptr) {
+                    process_lines(begin, last - begin + 1);
+                    if (Policy::is_done()) break;
+                    rest = last + 1;
+                }
+
+                // Move the unfinished line right before the next aligned offset.
+                tail = begin + len - rest;
+                char *dst = data + (tail + alignment - 1) / alignment * alignment - tail;
+                if ((tail > 0) && (dst != rest)) memmove(dst, rest, tail);
+            }
+            Policy::finalize();
+        }
+
+        // Search the current block while an I/O thread reads the next ones so the search time is close to
+        // max(I/O time, CPU time) instead of their sum. The unfinished line at the end of a block is moved
+        // into the headroom of the next block, which grows if the line does not fit into it. The I/O
+        // thread owns the shared buffers so we do not wait for a blocked read of a pipe if the policy does
+        // not need more data.
+        void read_ahead(const int fd, const size_t nbytes_per_read) {
+            constexpr size_t NBLOCKS = 3;
+            using Block = ReadAheadBuffers::Block;
+            auto buffers = std::make_shared<ReadAheadBuffers>(NBLOCKS, nbytes_per_read);
+            for (size_t idx = 0; idx < NBLOCKS; ++idx) buffers->empty_blocks.push(size_t(idx));
+            std::thread producer([buffers, fd]() {
+                size_t idx;
+                while (buffers->empty_blocks.pop(idx)) {
+                    std::vector<char> &data = buffers->blocks[idx];
+                    Block block;
+                    block.index = idx;
+                    block.offset = buffers->headroom.load(std::memory_order_relaxed);
+
+                    // Leave room for the EOL of the last line.
+                    const size_t required = block.offset + buffers->block_size + 1;
+                    if (data.size() < required) data.resize(required);
+                    do {
+                        block.size = ::read(fd, data.data() + block.offset, buffers->block_size);
+                    } while ((block.size < 0) && (errno == EINTR));
+                    block.error = errno;
+                    const bool is_last = block.size <= 0;
+                    buffers->filled_blocks.push(std::move(block));
+                    if (is_last) break;
+                }
+                buffers->filled_blocks.close();
+            });
+
+            bool is_eof = false;
+            Block block;
+            char *tail = nullptr; // The unfinished line of the last searched block which is still ours.
+            size_t tail_size = 0;
+            size_t tail_block = 0;
+            while (buffers->filled_blocks.pop(block)) {
+                if (block.size <= 0) {
+                    if (block.size < 0) {
+                        errno = block.error;
+                        perror("read");
+                    }
+                    is_eof = true;
+                    break;
+                }
+
+                // Move the unfinished line in front of the new data then give its block back.
+                std::vector<char> &data = buffers->blocks[block.index];
+                size_t start = block.offset;
+                if (tail_size > start) {
+                    data.resize(std::max(data.size(), tail_size + block.size + 1));
+                    memmove(data.data() + tail_size, data.data() + start, block.size);
+                    start = tail_size;
+                    const size_t headroom = buffers->headroom.load(std::memory_order_relaxed);
+                    buffers->headroom.store(std::max(headroom, 2 * tail_size), std::memory_order_relaxed);
+                }
+                char *begin = data.data() + start - tail_size;
+                if (tail != nullptr) {
+                    memcpy(begin, tail, tail_size);
+                    buffers->empty_blocks.push(size_t(tail_block));
+                }
+
+                char *end = data.data() + start + block.size;
+                const char *last = static_cast<const char *>(memrchr(data.data() + start, EOL, block.size));
+                tail = begin;
+                tail_size = end - begin;
+                tail_block = block.index;
+                if (last != nullptr) {
+                    process_lines(begin, last - begin + 1);
+                    tail = begin + (last - begin) + 1;
+                    tail_size = end - tail;
+                    if (Policy::is_done()) break;
+                }
+            }
+
+            // Reads of regular files do not block so we only detach the I/O thread if it might be waiting
+            // for data from a pipe.
+            buffers->empty_blocks.close();
+            struct stat info;
+            if (is_eof || ((fstat(fd, &info) == 0) && S_ISREG(info.st_mode))) {
+                producer.join();
+            } else {
+                producer.detach();
+            }
+
+            // The block of the unfinished line is not given back so it still has room for its EOL.
+            if ((tail_size > 0) && !Policy::is_done()) {
+                tail[tail_size] = EOL;
+                process_lines(tail, tail_size + 1);
+            }
+            Policy::finalize();
+        }
+
+        // Bypass the page cache. Reads fall back to buffered reads if the file system does not support
+        // O_DIRECT.
+        void read_direct(const int fd, const size_t buffer_size) {
+            constexpr size_t alignment = AlignedBuffer::ALIGNMENT;
+            const int flags = fcntl(fd, F_GETFL);
+            if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_DIRECT) < 0)) {
+                read(fd, buffer_size);
+                return;
+            }
+            const size_t nbytes_per_read = (buffer_size + alignment - 1) / alignment * alignment;
+            read(fd, nbytes_per_read, alignment);
+        }
+
+        // Search a memory mapped file. Policies get blocks of complete lines so consoles and early exit
+        // modes work the same way as with the read based approach. Note that the file must not be
+        // truncated while we are searching it.
+        void read_mmap(const int fd, const size_t size, const bool willneed) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                read(fd, read_size);
+                return;
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            if (willneed) madvise(mapped, size, MADV_WILLNEED);
+
+            const char *begin = static_cast<const char *>(mapped);
+            const char *end = begin + size;
+            while (begin < end) {
+                const size_t block_size = std::min(io::LARGE_BUFFER_SIZE, static_cast<size_t>(end - begin));
+                const char *block_end = begin + block_size;
+                const char *last = static_cast<const char *>(memrchr(begin, EOL, block_end - begin));
+                if ((last == nullptr) && (block_end < end)) {
+                    last = static_cast<const char *>(memchr(block_end, EOL, end - block_end));
+                }
+                if (last == nullptr) break;
+                process_lines(begin, last - begin + 1);
+                begin = last + 1;
+                if (Policy::is_done()) break;
+            }
+
+            // The last line does not end with EOL so it is copied to our buffer.
+            if ((begin < end) && !Policy::is_done()) {
+                const size_t tail = end - begin;
+                if (buffer.size() < tail + 1) buffer.resize(tail + 1);
+                memcpy(buffer.data(), begin, tail);
+                buffer.data()[tail] = EOL;
+                process_lines(buffer.data(), tail + 1);
+            }
+
+            munmap(mapped, size);
+            Policy::finalize();
+        }
+    };
+
+    // Read data from a given file descriptor for example STDIN.
+    template <typename Policy> class StreamReader : public FileReader<Policy> {
+      public:
+        template <typename... Args>
+        StreamReader(Args &&... args) : FileReader<Policy>(std::forward<Args>(args)...) {}
+
+        // Standard input is read ahead unless users select another I/O method.
+        void operator()(const int fd) {
+            if (this->adaptive || (this->method == IOMethod::READ_AHEAD)) {
+                this->read_ahead(fd, this->read_size);
+            } else {
+                this->read(fd, this->read_size);
+            }
+        }
+    };
+} // namespace fastgrep
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "constants.hpp"
+#include "fmt/format.h"
+#include "output.hpp"
+#include "scanners.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace fastgrep {
+    // ScanPolicy has the same interface as StreamPolicy, however, it scans all complete lines of a buffer
+    // using a single scanner call and only looks at the lines that contain a match. This approach is
+    // much faster than the line by line approach if most of the lines do not match the given pattern.
+    template <typename Scanner, typename Console = FMTPolicy> class ScanPolicy {
+      public:
+        template <typename Params>
+        ScanPolicy(const std::string &patt, Params &&params)
+            : scanner(patt, params.regex_mode), lines(1), pos(0), linebuf(), console(),
+              color(params.color()), linenum(params.linenum()), quite(params.quite()),
+              files_with_matches(params.files_with_matches()), show_pattern(params.show_pattern()),
+              max_count((quite || files_with_matches) ? 1 : params.max_count) {}
+
+        void process(const char *begin, const size_t len) {
+            const char *start = begin;
+            const char *end = begin + len;
+
+            // Complete the line that is started in the previous buffer. The readers in reader.hpp only
+            // pass complete lines so this only happens with other callers.
+            if (!linebuf.empty()) {
+                const char *ptr = static_cast<const char *>(memchr(begin, EOL, len));
+                if (ptr == nullptr) {
+                    linebuf.append(begin, len);
+                    pos += len;
+                    return;
+                }
+                linebuf.append(start, ptr - start + 1);
+                process_line(linebuf.data(), linebuf.size());
+                console.flush();
+                linebuf.clear();
+                start = ++ptr;
+                ++lines;
+                if (is_done()) return;
+            }
+
+            // Only scan complete lines and keep the leftover data in the line buffer.
+            const char *last = static_cast<const char *>(memrchr(start, EOL, end - start));
+            if (last != nullptr) {
+                scan(start, last + 1);
+                start = last + 1;
+            }
+            if ((start < end) && !is_done()) { linebuf.append(start, end - start); }
+            pos += len;
+            console.flush();
+        }
+
+        Console &get_console() { return console; }
+
+        // Return true if we do not need to search the current file anymore.
+        bool is_done() const { return (max_count > 0) && (matches >= max_count); }
+
+        // The total number of matched lines in all searched files.
+        size_t number_of_matches() const { return total_matches; }
+
+        // Readers call this method if they skip lines that do not match.
+        void skip_lines(const size_t nlines) { lines += nlines; }
+
+      protected:
+        Scanner scanner;
+        size_t lines = 1;
+        size_t pos = 0;
+        std::string linebuf;
+        Console console;
+        bool color = false;
+        bool linenum = false;
+        bool quite = false;
+        bool files_with_matches = false;
+        bool show_pattern = false;
+        size_t max_count = 0;
+        size_t matches = 0;
+        size_t total_matches = 0;
+        const char *file = nullptr;
+
+        // Scan a block of complete lines. Scanning restarts at the beginning of the next line after
+        // each candidate line so anchors work as expected. Line numbers are only computed for printed
+        // lines by counting EOL from the previous printed line.
+        void scan(const char *begin, const char *end) {
+            const char *start = begin;
+            const char *counted = begin;
+            const char *match_end;
+            while ((start < end) && !is_done() && (match_end = scanner.find(start, end))) {
+                const char *last_char = (match_end > start) ? match_end - 1 : start;
+                const char *line_begin = static_cast<const char *>(memrchr(start, EOL, last_char - start));
+                line_begin = (line_begin == nullptr) ? start : line_begin + 1;
+                const char *line_end = static_cast<const char *>(memchr(last_char, EOL, end - last_char));
+                const size_t line_len = line_end - line_begin + 1;
+                if (scanner.verify(line_begin, line_len)) {
+                    if (linenum) {
+                        lines += simd::count(counted, line_begin, EOL);
+                        counted = line_begin;
+                    }
+                    print_line(line_begin, line_len);
+                }
+                start = line_end + 1;
+            }
+            if (linenum) { lines += simd::count(counted, end, EOL); }
+        }
+
+        void process_line(const char *begin, const size_t len) {
+            if (scanner.find(begin, begin + len) && scanner.verify(begin, len)) { print_line(begin, len); }
+        }
+
+        void print_line(const char *begin, const size_t len) {
+            ++matches;
+            ++total_matches;
+            if (quite) return;
+            if (files_with_matches) {
+                const char *fname = file ? file : "(standard input)";
+                console.print_plain_text(fname, fname + strlen(fname));
+                return;
+            }
+
+            const size_t buflen = len - 1;
+            if (!color) {
+                if (file) { console.print_filename(file); }
+                if (show_pattern) { console.print_filename(scanner.matched_pattern().c_str()); }
+                if (!linenum) {
+                    console.print_plain_text(begin, begin + buflen);
+                } else {
+                    console.print_plain_text(begin, begin + buflen, lines);
+                }
+            } else {
+                if (file) { console.print_color_filename(file); }
+                if (show_pattern) { console.print_color_filename(scanner.matched_pattern().c_str()); }
+                if (!linenum) {
+                    console.print_color_text(begin, begin + buflen);
+                } else {
+                    console.print_color_text(begin, begin + buflen, lines);
+                }
+            }
+        }
+
+        // Set the file name so we can display our results better. This method is called before we search
+        // a new file so we also reset all per-file states.
+        void set_filename(const char *fname) {
+            file = fname;
+            linebuf.clear();
+            lines = 1;
+            pos = 0;
+            matches = 0;
+        }
+
+        // Process the last line if it does not end with EOL.
+        void finalize() {
+            if (!linebuf.empty()) {
+                linebuf.push_back(EOL);
+                process_line(linebuf.data(), linebuf.size());
+                console.flush();
+                linebuf.clear();
+            }
+            lines = 1;
+            pos = 0;
+        }
+    };
+} // namespace fastgrep
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "constants.hpp"
+#include "database.hpp"
+#include "fmt/format.h"
+#include "hs/hs.h"
+#include "literals.hpp"
+#include "simd.hpp"
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace fastgrep {
+    // Scanners find the first match inside a buffer which can hold many lines. They are used by policies
+    // which only want to look at the lines that contain a match instead of checking every line.
+    namespace hyperscan {
+        // Escape all special characters so a literal pattern can be used as a regular expression.
+        inline std::string escape(const std::string &patt) {
+            std::string results;
+            for (const char c : patt) {
+                if (!isalnum(static_cast<unsigned char>(c))) {
+                    results.append(fmt::format("\\x{:02x}", static_cast<unsigned char>(c)));
+                } else {
+                    results.push_back(c);
+                }
+            }
+            return results;
+        }
+
+        // MultiScanner compiles many patterns into a single database so a buffer is scanned only once no
+        // matter how many patterns we have. Patterns are separated by EOL which is also the format of
+        // pattern files. The pattern ids are the pattern indexes so we can tell users which pattern
+        // matches a line. The buffer database is compiled in multiline mode and it reports all matches so
+        // we can stop at the first one. Each candidate line is then verified by the line database which
+        // uses the same flags as utils::hyperscan::RegexMatcher so the search results are identical to
+        // the line based policies.
+        class MultiScanner {
+          public:
+            MultiScanner(const std::string &patts, const int mode) : MultiScanner(split(patts), mode) {}
+
+            MultiScanner(std::vector<std::string> &&patts, const int mode)
+                : MultiScanner(std::vector<std::string>(patts), patts, mode) {}
+
+            // Compile the given regular expressions and report the matched pattern using the patterns
+            // given by users which have the same order.
+            MultiScanner(std::vector<std::string> &&patts, const std::vector<std::string> &regexes,
+                         const int mode)
+                : patterns(std::move(patts)), buffer_database(nullptr), line_database(nullptr),
+                  scratch(nullptr), pattern_id(0) {
+                buffer_database = compile(regexes, (mode & ~HS_FLAG_SINGLEMATCH) | HS_FLAG_MULTILINE);
+                try {
+                    line_database = compile(regexes, mode);
+                } catch (...) {
+                    hs_free_database(buffer_database);
+                    throw;
+                }
+
+                // A scratch space can be shared by many databases.
+                if ((hs_alloc_scratch(buffer_database, &scratch) != HS_SUCCESS) ||
+                    (hs_alloc_scratch(line_database, &scratch) != HS_SUCCESS)) {
+                    hs_free_scratch(scratch);
+                    hs_free_database(buffer_database);
+                    hs_free_database(line_database);
+                    throw std::runtime_error("Cannot allocate scratch space for hyperscan.");
+                }
+            }
+
+            MultiScanner(const MultiScanner &) = delete;
+            MultiScanner &operator=(const MultiScanner &) = delete;
+
+            ~MultiScanner() {
+                hs_free_scratch(scratch);
+                hs_free_database(buffer_database);
+                hs_free_database(line_database);
+            }
+
+            // Return the pointer to the end of the first match of any pattern or nullptr if there is no
+            // match.
+            const char *find(const char *begin, const char *end) {
+                Context context{0, 0, false};
+                hs_scan(buffer_database, begin, end - begin, 0, scratch, event_handler, &context);
+                return context.found ? begin + context.offset : nullptr;
+            }
+
+            // Check that a candidate line does match one of the patterns and remember that pattern.
+            bool verify(const char *begin, const size_t len) {
+                Context context{0, 0, false};
+                hs_scan(line_database, begin, len, 0, scratch, event_handler, &context);
+                if (context.found) pattern_id = context.id;
+                return context.found;
+            }
+
+            // The pattern that matches the last verified line.
+            const std::string &matched_pattern() const { return patterns[pattern_id]; }
+
+            size_t size() const { return patterns.size(); }
+
+          protected:
+            static std::vector<std::string> split(const std::string &patts) {
+                std::vector<std::string> results;
+                size_t begin = 0;
+                while (begin <= patts.size()) {
+                    size_t end = patts.find(EOL, begin);
+                    if (end == std::string::npos) end = patts.size();
+                    if (end > begin) results.emplace_back(patts.substr(begin, end - begin));
+                    begin = end + 1;
+                }
+                if (results.empty()) throw std::runtime_error("The list of search patterns is empty.");
+                return results;
+            }
+
+          private:
+            struct Context {
+                size_t offset;
+                unsigned int id;
+                bool found;
+            };
+
+            static int event_handler(unsigned int id, unsigned long long, unsigned long long to,
+                                     unsigned int, void *ctx) {
+                auto context = static_cast<Context *>(ctx);
+                context->offset = to;
+                context->id = id;
+                context->found = true;
+                return 1; // Stop at the first match.
+            }
+
+            std::vector<std::string> patterns;
+            hs_database_t *buffer_database;
+            hs_database_t *line_database;
+            hs_scratch_t *scratch;
+            unsigned int pattern_id;
+        };
+
+        // A MultiScanner for literal patterns. Patterns are escaped before they are compiled but the
+        // matched pattern is the literal given by users.
+        class ExactMultiScanner : public MultiScanner {
+          public:
+            ExactMultiScanner(const std::string &patts, const int mode)
+                : ExactMultiScanner(split(patts), mode) {}
+
+          private:
+            ExactMultiScanner(std::vector<std::string> &&patts, const int mode)
+                : MultiScanner(std::vector<std::string>(patts), escape(patts), mode) {}
+
+            static std::vector<std::string> escape(const std::vector<std::string> &patts) {
+                std::vector<std::string> results;
+                for (auto const &patt : patts) results.emplace_back(hyperscan::escape(patt));
+                return results;
+            }
+        };
+
+        // A scanner for a single pattern. If every match of the pattern contains one of a few literals
+        // then candidate lines are found using memmem and hyperscan only verifies those lines.
+        class Scanner : public MultiScanner {
+          public:
+            Scanner(const std::string &patt, const int mode)
+                : MultiScanner(std::vector<std::string>{patt}, mode),
+                  prefilter(literals::required_literals(patt, mode)) {}
+
+            const char *find(const char *begin, const char *end) {
+                return prefilter.empty() ? MultiScanner::find(begin, end) : prefilter.find(begin, end);
+            }
+
+          private:
+            literals::Prefilter prefilter;
+        };
+
+    } // namespace hyperscan
+
+    // A literal pattern cannot span lines so a match found by simd::find does not need to be verified.
+    class ExactScanner {
+      public:
+        ExactScanner(const std::string &patt, const int) : pattern(patt) {}
+
+        const char *find(const char *begin, const char *end) {
+            if (pattern.empty()) return begin < end ? begin + 1 : nullptr;
+            const char *ptr = simd::find(begin, end, pattern.data(), pattern.size());
+            return ptr ? ptr + pattern.size() : nullptr;
+        }
+
+        bool verify(const char *, const size_t) { return true; }
+
+        const std::string &matched_pattern() const { return pattern; }
+
+      private:
+        std::string pattern;
+    };
+
+    // Use a scanner as a line matcher. This allows line based policies such as StreamPolicy and
+    // SimplePolicy to work with scanners.
+    template <typename Scanner> class ScanMatcher {
+      public:
+        ScanMatcher(const std::string &patt, const int mode) : scanner(patt, mode) {}
+
+        bool is_matched(const char *begin, const size_t len) {
+            return scanner.find(begin, begin + len) && scanner.verify(begin, len);
+        }
+
+        // Return the pointer to the end of the first candidate in a buffer or nullptr. Lines before the
+        // candidate line do not match.
+        const char *find(const char *begin, const char *end) { return scanner.find(begin, end); }
+
+      private:
+        Scanner scanner;
+    };
+
+    // Find lines that do not match the given pattern.
+    template <typename Scanner> class ScanMatcherInv {
+      public:
+        ScanMatcherInv(const std::string &patt, const int mode) : scanner(patt, mode) {}
+
+        bool is_matched(const char *begin, const size_t len) {
+            return !(scanner.find(begin, begin + len) && scanner.verify(begin, len));
+        }
+
+      private:
+        Scanner scanner;
+    };
+
+    // Line matchers which can find the next candidate line in a buffer so policies can skip all lines
+    // before it.
+    template <typename Matcher> struct can_skip : std::false_type {};
+    template <typename Scanner> struct can_skip<ScanMatcher<Scanner>> : std::true_type {};
+} // namespace fastgrep
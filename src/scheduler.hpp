@@ -0,0 +1,146 @@
+#pragma once
+
+#include "queue.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fastgrep {
+    // A task queue owned by a worker. The owner takes tasks from the front of the queue so tasks are
+    // processed in the order they are found and other workers steal tasks from the back of the queue.
+    template <typename Task> class TaskQueue {
+      public:
+        void push(Task &&task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+
+        bool pop(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+
+        bool steal(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) return false;
+            task = std::move(tasks.back());
+            tasks.pop_back();
+            return true;
+        }
+
+      private:
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Distribute tasks from a shared queue to a pool of workers. A worker takes a small batch of tasks
+    // from the shared queue when it runs out of work, and it will steal tasks from other workers before
+    // touching the shared queue. Idle workers sleep until the shared queue has data or it is closed.
+    template <typename Task> class Scheduler {
+      public:
+        static constexpr size_t BATCH_SIZE = 8;
+
+        Scheduler(const size_t nthreads, BoundedQueue<Task> &tasks) : queues(nthreads), source(tasks) {}
+
+        ~Scheduler() { join(); }
+
+        // Get the next task for a given worker. Return false if there is no more task.
+        bool next(const size_t worker, Task &task) {
+            const size_t nthreads = queues.size();
+            while (true) {
+                if (queues[worker].pop(task)) return true;
+                for (size_t idx = 1; idx < nthreads; ++idx) {
+                    if (queues[(worker + idx) % nthreads].steal(task)) return true;
+                }
+
+                if (source.try_pop(task)) {
+                    Task other;
+                    for (size_t idx = 1; (idx < BATCH_SIZE) && source.try_pop(other); ++idx) {
+                        queues[worker].push(std::move(other));
+                    }
+                    return true;
+                }
+
+                if (source.is_closed()) return source.try_pop(task);
+                source.wait();
+            }
+        }
+
+        // Start all workers. Each worker will call the given function with its worker id.
+        template <typename Function> void start(Function &&fn) {
+            for (size_t worker = 0; worker < queues.size(); ++worker) { threads.emplace_back(fn, worker); }
+        }
+
+        void join() {
+            for (auto &athread : threads) athread.join();
+            threads.clear();
+        }
+
+      private:
+        std::vector<TaskQueue<Task>> queues;
+        BoundedQueue<Task> &source;
+        std::vector<std::thread> threads;
+    };
+
+    // Collect the output of all tasks and write them to the STDOUT in the order of tasks. The total number
+    // of tasks is not known until the producer calls close.
+    class OrderedOutput {
+      public:
+        void set(const size_t task, std::string &&data) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                buffers[task] = std::move(data);
+            }
+            cv.notify_one();
+        }
+
+        void close(const size_t ntasks) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                total = ntasks;
+                closed = true;
+            }
+            cv.notify_one();
+        }
+
+        // Write the output of all tasks to the STDOUT. This function will block until all tasks are done.
+        void write() {
+            write([](const std::string &data) {
+                if (!data.empty()) fwrite(data.data(), 1, data.size(), stdout);
+            });
+            fflush(stdout);
+        }
+
+        // Pass the output of each task to the sink in the order of tasks. This function will block until
+        // all tasks are done.
+        template <typename Sink> void write(Sink &&sink) {
+            for (size_t task = 0;; ++task) {
+                std::string data;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [this, task] { return (buffers.count(task) > 0) || (closed && task >= total); });
+                    auto it = buffers.find(task);
+                    if (it == buffers.end()) break;
+                    data.swap(it->second);
+                    buffers.erase(it);
+                }
+                sink(data);
+            }
+        }
+
+      private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::unordered_map<size_t, std::string> buffers;
+        size_t total = 0;
+        bool closed = false;
+    };
+} // namespace fastgrep
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "queue.hpp"
+#include <string>
+#include <utility>
+
+namespace fastgrep {
+    // A file that needs to be searched and its position in the traversal order.
+    struct SearchTask {
+        size_t index = 0;
+        std::string path;
+    };
+
+    using PathQueue = BoundedQueue<SearchTask>;
+
+    // QueueStorePolicy throws this to stop a traversal because consumers do not need more files.
+    struct TraversalStopped {};
+
+    // Push found files to a queue so they can be searched while we are still traversing the search paths.
+    // The base policy is one of the ioutils store policies and it decides which files will be stored. The
+    // traversal is stopped as soon as consumers close the queue e.g we only need the first match.
+    template <typename Base> class QueueStorePolicy : public Base {
+      public:
+        template <typename... Args> QueueStorePolicy(Args &&... args) : Base(std::forward<Args>(args)...) {}
+
+        void set_queue(PathQueue *aqueue) { queue = aqueue; }
+
+        // The number of files pushed to the queue.
+        size_t size() const { return counter; }
+
+      protected:
+        template <typename... Args> void process_file(Args &&... args) {
+            if (queue->is_closed()) throw TraversalStopped();
+            Base::process_file(std::forward<Args>(args)...);
+            for (auto &apath : this->paths) {
+                SearchTask task;
+                task.index = counter;
+                task.path = std::move(apath);
+                if (!queue->push(std::move(task))) {
+                    this->paths.clear();
+                    throw TraversalStopped();
+                }
+                ++counter;
+            }
+            this->paths.clear();
+        }
+
+      private:
+        PathQueue *queue = nullptr;
+        size_t counter = 0;
+    };
+
+    // Traverse the search paths until all files are found or consumers close the queue. Return the number
+    // of files pushed to the queue.
+    template <typename Search, typename Paths> size_t traverse(Search &search, const Paths &paths) {
+        try {
+            search.traverse(paths);
+        } catch (const TraversalStopped &) {}
+        return search.size();
+    }
+} // namespace fastgrep
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "constants.hpp"
+#include "literals.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace fastgrep {
+    // A sidecar index describes an immutable log file, for example a rotated scribe log, so repeated
+    // searches can skip the blocks that cannot match. A file is split into blocks of block_lines lines and
+    // the index of each block has its byte offset, its first line number, and a bloom filter of all byte
+    // trigrams of its lines. We use trigrams instead of words because a pattern can match any part of a
+    // word. Blocks do not have timestamp ranges because time windows of sorted logs are found using a
+    // binary search which reads fewer bytes than the index of a big file. The index of "foo.log" is stored
+    // in "foo.log.fgidx" together with the size and the modification time of "foo.log" so a stale index
+    // is never used.
+    namespace sidecar {
+        constexpr char SUFFIX[] = ".fgidx";
+        constexpr char MAGIC[8] = {'F', 'G', 'I', 'D', 'X', 0, 0, 0};
+        constexpr uint32_t VERSION = 2;
+        constexpr size_t DEFAULT_BLOCK_LINES = 4096;
+
+        // A 16KB filter per block has about 5% false positives per trigram even if a block has 20000
+        // distinct trigrams, and a literal is a false positive only if all of its trigrams are.
+        constexpr size_t BLOOM_BITS = 1 << 17;
+        constexpr size_t BLOOM_WORDS = BLOOM_BITS / 64;
+        constexpr size_t NHASHES = 3;
+
+        inline std::string path(const std::string &datafile) { return datafile + SUFFIX; }
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t block_lines;
+            uint64_t bloom_bits;
+            uint64_t file_size;
+            int64_t mtime_sec;
+            int64_t mtime_nsec;
+            uint64_t nlines;
+            uint64_t nblocks;
+        };
+
+        struct Block {
+            uint64_t offset; // The offset of the first line.
+            uint64_t line;   // The number of lines before this block.
+        };
+
+        static_assert(sizeof(Header) == 64, "The index header must not have any padding.");
+        static_assert(sizeof(Block) == 16, "The block index must not have any padding.");
+
+        // Compute the bloom filter bits of a trigram using double hashing.
+        template <typename F> void for_each_bit(const uint32_t trigram, F &&f) {
+            const uint64_t hash = trigram * 0x9E3779B97F4A7C15ULL;
+            const uint64_t h1 = hash >> 32;
+            const uint64_t h2 = (hash & 0xffffffff) | 1;
+            for (size_t idx = 0; idx < NHASHES; ++idx) f((h1 + idx * h2) & (BLOOM_BITS - 1));
+        }
+
+        class Index {
+          public:
+            size_t size() const { return blocks.size(); }
+            size_t number_of_lines() const { return header.nlines; }
+            const Block &block(const size_t idx) const { return blocks[idx]; }
+
+            // The number of lines of a block.
+            size_t lines(const size_t idx) const {
+                const size_t next_line = (idx + 1 < blocks.size()) ? blocks[idx + 1].line : header.nlines;
+                return next_line - blocks[idx].line;
+            }
+
+            // The offset right after the last line of a block.
+            size_t end_offset(const size_t idx) const {
+                return (idx + 1 < blocks.size()) ? blocks[idx + 1].offset : header.file_size;
+            }
+
+            bool has_bit(const size_t idx, const size_t bit) const {
+                return (blooms[idx * BLOOM_WORDS + bit / 64] >> (bit % 64)) & 1;
+            }
+
+            // Load the index of a file. Return false if the index does not exist, is invalid, or is built
+            // for another version of the file.
+            bool load(const std::string &fname, const struct stat &info) {
+                std::unique_ptr<FILE, int (*)(FILE *)> fp(fopen(fname.data(), "rb"), fclose);
+                if (!fp || (fread(&header, sizeof(Header), 1, fp.get()) != 1)) return false;
+                if ((memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION) ||
+                    (header.bloom_bits != BLOOM_BITS) || !is_same_file(header, info)) {
+                    return false;
+                }
+                blocks.resize(header.nblocks);
+                blooms.resize(header.nblocks * BLOOM_WORDS);
+                return (fread(blocks.data(), sizeof(Block), blocks.size(), fp.get()) == blocks.size()) &&
+                       (fread(blooms.data(), sizeof(uint64_t), blooms.size(), fp.get()) == blooms.size());
+            }
+
+            // Write the index to a temporary file then rename it so readers never see a partial index.
+            void save(const std::string &fname, const struct stat &info) {
+                memcpy(header.magic, MAGIC, sizeof(MAGIC));
+                header.version = VERSION;
+                header.bloom_bits = BLOOM_BITS;
+                header.file_size = info.st_size;
+                header.mtime_sec = info.st_mtim.tv_sec;
+                header.mtime_nsec = info.st_mtim.tv_nsec;
+                header.nblocks = blocks.size();
+
+                const std::string tmp_file = fname + ".tmp";
+                FILE *fp = fopen(tmp_file.data(), "wb");
+                if (fp == nullptr) throw std::runtime_error("Cannot create the index file: " + tmp_file);
+                const bool is_ok =
+                    (fwrite(&header, sizeof(Header), 1, fp) == 1) &&
+                    (fwrite(blocks.data(), sizeof(Block), blocks.size(), fp) == blocks.size()) &&
+                    (fwrite(blooms.data(), sizeof(uint64_t), blooms.size(), fp) == blooms.size());
+                if ((fclose(fp) != 0) || !is_ok || (rename(tmp_file.data(), fname.data()) != 0)) {
+                    remove(tmp_file.data());
+                    throw std::runtime_error("Cannot write the index file: " + fname);
+                }
+            }
+
+          protected:
+            Header header{};
+            std::vector<Block> blocks;
+            std::vector<uint64_t> blooms;
+
+            static bool is_same_file(const Header &header, const struct stat &info) {
+                return (header.file_size == static_cast<uint64_t>(info.st_size)) &&
+                       (header.mtime_sec == info.st_mtim.tv_sec) &&
+                       (header.mtime_nsec == info.st_mtim.tv_nsec);
+            }
+        };
+
+        // Builder is a reader policy which builds the index of a file from its lines.
+        class Builder : public Index {
+          public:
+            explicit Builder(const size_t nlines = DEFAULT_BLOCK_LINES)
+                : block_lines(std::max<size_t>(nlines, 1)) {}
+
+            void process(const char *begin, const size_t len) {
+                const char *start = begin;
+                const char *end = begin + len;
+                const char *ptr;
+                while ((start < end) && (ptr = simd::find_char(start, end, EOL))) {
+                    if (block_size == 0) add_block(offset + (start - begin));
+                    add_line(start, ptr);
+                    if (++block_size == block_lines) block_size = 0;
+                    start = ptr + 1;
+                }
+                offset += len;
+            }
+
+            bool is_done() const { return false; }
+
+          protected:
+            void set_filename(const char *) {
+                header = Header();
+                header.block_lines = block_lines;
+                blocks.clear();
+                blooms.clear();
+                offset = 0;
+                block_size = 0;
+            }
+
+            void finalize() {}
+
+          private:
+            size_t block_lines;
+            size_t offset = 0;
+            size_t block_size = 0;
+
+            void add_block(const size_t pos) {
+                blocks.push_back(Block{pos, header.nlines});
+                blooms.resize(blooms.size() + BLOOM_WORDS, 0);
+            }
+
+            void add_line(const char *begin, const char *end) {
+                uint64_t *bloom = blooms.data() + blooms.size() - BLOOM_WORDS;
+                auto set_bit = [bloom](const size_t bit) { bloom[bit / 64] |= 1ULL << (bit % 64); };
+                uint32_t trigram = 0;
+                for (const char *ptr = begin; ptr < end; ++ptr) {
+                    trigram = ((trigram << 8) | static_cast<unsigned char>(*ptr)) & 0xffffff;
+                    if (ptr - begin >= 2) for_each_bit(trigram, set_bit);
+                }
+                ++header.nlines;
+            }
+        };
+
+        // A block may match if it has all trigrams of one of the required literals of the search patterns.
+        // An empty list of literals matches all blocks.
+        class Query {
+          public:
+            Query() = default;
+            explicit Query(const literals::Literals &items) {
+                for (auto const &item : items) {
+                    // A short literal does not have any trigram so we cannot skip any block.
+                    if (item.size() < 3) {
+                        bits.clear();
+                        return;
+                    }
+                    std::vector<size_t> positions;
+                    uint32_t trigram = 0;
+                    for (size_t idx = 0; idx < item.size(); ++idx) {
+                        trigram = ((trigram << 8) | static_cast<unsigned char>(item[idx])) & 0xffffff;
+                        if (idx < 2) continue;
+                        for_each_bit(trigram, [&positions](const size_t bit) { positions.push_back(bit); });
+                    }
+                    bits.emplace_back(std::move(positions));
+                }
+            }
+
+            bool may_match(const Index &index, const size_t idx) const {
+                if (bits.empty()) return true;
+                for (auto const &positions : bits) {
+                    auto has_bit = [&index, idx](const size_t bit) { return index.has_bit(idx, bit); };
+                    if (std::all_of(positions.begin(), positions.end(), has_bit)) return true;
+                }
+                return false;
+            }
+
+          private:
+            std::vector<std::vector<size_t>> bits; // The bloom filter bits of each literal.
+        };
+    } // namespace sidecar
+} // namespace fastgrep
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTGREP_X86
+#endif
+
+namespace fastgrep {
+    // SIMD kernels for exact matching and newline indexing. Each kernel has SSE2, AVX2, and AVX-512
+    // versions which are compiled using target attributes, and the best version supported by the CPU is
+    // selected once at the first call. This allows us to ship one binary which is built for the baseline
+    // x86-64 CPU and still uses AVX2 or AVX-512 if they are available. The FASTGREP_SIMD environment
+    // variable, i.e scalar, sse2, or avx2, can be used to select a lower instruction set.
+    namespace simd {
+        enum class ISA { SCALAR, SSE2, AVX2, AVX512 };
+
+        struct Kernels {
+            ISA isa;
+
+            // Return the pointer to the first c or nullptr.
+            const char *(*find_char)(const char *begin, const char *end, const char c);
+
+            // Return the number of c.
+            size_t (*count)(const char *begin, const char *end, const char c);
+
+            // Return the pointer to the first occurrence of a needle which has at least two bytes.
+            const char *(*find)(const char *begin, const char *end, const char *needle, const size_t len);
+
+            // Set bit i of the bitmap if begin[i] is c. The bitmap must have (end - begin + 63) / 64 words.
+            void (*bitmap)(const char *begin, const char *end, const char c, uint64_t *bits);
+
+            // Return the number of set bits of n > 0 words. The first and the last words are masked.
+            size_t (*popcount)(const uint64_t *words, const size_t n, const uint64_t first_mask,
+                               const uint64_t last_mask);
+        };
+
+        namespace scalar {
+            inline const char *find_char(const char *begin, const char *end, const char c) {
+                return static_cast<const char *>(memchr(begin, c, end - begin));
+            }
+
+            inline size_t count(const char *begin, const char *end, const char c) {
+                return std::count(begin, end, c);
+            }
+
+            inline const char *find(const char *begin, const char *end, const char *needle,
+                                    const size_t len) {
+                return static_cast<const char *>(memmem(begin, end - begin, needle, len));
+            }
+
+            // Only the bits of the last word are set here so SIMD kernels can use it for the leftover data.
+            inline void bitmap(const char *begin, const char *end, const char c, uint64_t *bits) {
+                const size_t len = end - begin;
+                if (len == 0) return;
+                uint64_t word = 0;
+                for (size_t idx = 0; idx < len; ++idx) {
+                    word |= static_cast<uint64_t>(begin[idx] == c) << (idx & 63);
+                    if ((idx & 63) == 63) {
+                        bits[idx >> 6] = word;
+                        word = 0;
+                    }
+                }
+                if ((len & 63) != 0) bits[len >> 6] = word;
+            }
+
+            inline size_t popcount(const uint64_t *words, const size_t n, const uint64_t first_mask,
+                                   const uint64_t last_mask) {
+                if (n == 1) return __builtin_popcountll(words[0] & first_mask & last_mask);
+                size_t results = __builtin_popcountll(words[0] & first_mask);
+                for (size_t idx = 1; idx + 1 < n; ++idx) results += __builtin_popcountll(words[idx]);
+                return results + __builtin_popcountll(words[n - 1] & last_mask);
+            }
+        } // namespace scalar
+
+#ifdef FASTGREP_X86
+// Generate the kernels of an instruction set. Vector is the SIMD register type, WIDTH is the number of
+// bytes of a register, LOAD loads a register, and EQ returns the bit mask of equal bytes of two
+// registers. POPCNT is enabled in every target, otherwise __builtin_popcountll is a libgcc call when the
+// binary is built for the baseline x86-64 CPU. The substring search compares the first and the last byte
+// of the needle at every position and only calls memcmp for positions where both of them match.
+#define FASTGREP_SIMD_KERNELS(TARGET, Vector, WIDTH, SET1, LOAD, EQ)                                       \
+    __attribute__((target(TARGET))) inline const char *find_char(const char *begin, const char *end,       \
+                                                                const char c) {                            \
+        const Vector pattern = SET1(c);                                                                    \
+        const char *ptr = begin;                                                                           \
+        for (; ptr + WIDTH <= end; ptr += WIDTH) {                                                         \
+            const uint64_t mask = EQ(LOAD(ptr), pattern);                                                  \
+            if (mask != 0) return ptr + __builtin_ctzll(mask);                                             \
+        }                                                                                                  \
+        return scalar::find_char(ptr, end, c);                                                             \
+    }                                                                                                      \
+                                                                                                           \
+    __attribute__((target(TARGET))) inline size_t count(const char *begin, const char *end,                \
+                                                        const char c) {                                    \
+        const Vector pattern = SET1(c);                                                                    \
+        size_t results = 0;                                                                                \
+        const char *ptr = begin;                                                                           \
+        for (; ptr + WIDTH <= end; ptr += WIDTH) {                                                         \
+            results += __builtin_popcountll(EQ(LOAD(ptr), pattern));                                       \
+        }                                                                                                  \
+        return results + scalar::count(ptr, end, c);                                                       \
+    }                                                                                                      \
+                                                                                                           \
+    __attribute__((target(TARGET))) inline const char *find(const char *begin, const char *end,            \
+                                                           const char *needle, const size_t len) {         \
+        const Vector first = SET1(needle[0]);                                                              \
+        const Vector last = SET1(needle[len - 1]);                                                         \
+        const char *ptr = begin;                                                                           \
+        for (; ptr + len - 1 + WIDTH <= end; ptr += WIDTH) {                                               \
+            uint64_t mask = EQ(LOAD(ptr), first) & EQ(LOAD(ptr + len - 1), last);                          \
+            while (mask != 0) {                                                                            \
+                const char *candidate = ptr + __builtin_ctzll(mask);                                       \
+                if (memcmp(candidate + 1, needle + 1, len - 2) == 0) return candidate;                     \
+                mask &= mask - 1;                                                                          \
+            }                                                                                              \
+        }                                                                                                  \
+        return scalar::find(ptr, end, needle, len);                                                        \
+    }                                                                                                      \
+                                                                                                           \
+    __attribute__((target(TARGET))) inline void bitmap(const char *begin, const char *end, const char c,   \
+                                                       uint64_t *bits) {                                   \
+        const Vector pattern = SET1(c);                                                                    \
+        const char *ptr = begin;                                                                           \
+        for (; ptr + 64 <= end; ptr += 64) {                                                               \
+            uint64_t word = 0;                                                                             \
+            for (size_t offset = 0; offset < 64; offset += WIDTH) {                                        \
+                word |= EQ(LOAD(ptr + offset), pattern) << offset;                                         \
+            }                                                                                              \
+            *bits++ = word;                                                                                \
+        }                                                                                                  \
+        scalar::bitmap(ptr, end, c, bits);                                                                 \
+    }                                                                                                      \
+                                                                                                           \
+    __attribute__((target(TARGET))) inline size_t popcount(const uint64_t *words, const size_t n,          \
+                                                           const uint64_t first_mask,                      \
+                                                           const uint64_t last_mask) {                     \
+        if (n == 1) return __builtin_popcountll(words[0] & first_mask & last_mask);                        \
+        size_t results = __builtin_popcountll(words[0] & first_mask);                                      \
+        for (size_t idx = 1; idx + 1 < n; ++idx) results += __builtin_popcountll(words[idx]);              \
+        return results + __builtin_popcountll(words[n - 1] & last_mask);                                  \
+    }
+
+        namespace sse2 {
+#define FASTGREP_SSE2_LOAD(ptr) _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr))
+#define FASTGREP_SSE2_EQ(x, y)                                                                             \
+    static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))))
+            FASTGREP_SIMD_KERNELS("sse2,popcnt", __m128i, 16, _mm_set1_epi8, FASTGREP_SSE2_LOAD,
+                                  FASTGREP_SSE2_EQ)
+        } // namespace sse2
+
+        namespace avx2 {
+#define FASTGREP_AVX2_LOAD(ptr) _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr))
+#define FASTGREP_AVX2_EQ(x, y)                                                                             \
+    static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))))
+            FASTGREP_SIMD_KERNELS("avx2,popcnt", __m256i, 32, _mm256_set1_epi8, FASTGREP_AVX2_LOAD,
+                                  FASTGREP_AVX2_EQ)
+        } // namespace avx2
+
+        namespace avx512 {
+#define FASTGREP_AVX512_LOAD(ptr) _mm512_loadu_si512(reinterpret_cast<const void *>(ptr))
+#define FASTGREP_AVX512_EQ(x, y) static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(x, y))
+            FASTGREP_SIMD_KERNELS("avx512f,avx512bw,popcnt", __m512i, 64, _mm512_set1_epi8,
+                                  FASTGREP_AVX512_LOAD, FASTGREP_AVX512_EQ)
+        } // namespace avx512
+
+#undef FASTGREP_SIMD_KERNELS
+#undef FASTGREP_SSE2_LOAD
+#undef FASTGREP_SSE2_EQ
+#undef FASTGREP_AVX2_LOAD
+#undef FASTGREP_AVX2_EQ
+#undef FASTGREP_AVX512_LOAD
+#undef FASTGREP_AVX512_EQ
+#endif
+
+        // Return true if the CPU supports the given instruction set. All SIMD kernels also need POPCNT.
+        inline bool is_supported(const ISA isa) {
+#ifdef FASTGREP_X86
+            __builtin_cpu_init();
+            if ((isa != ISA::SCALAR) && !__builtin_cpu_supports("popcnt")) return false;
+            switch (isa) {
+            case ISA::AVX512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+            case ISA::AVX2:
+                return __builtin_cpu_supports("avx2");
+            case ISA::SSE2:
+                return __builtin_cpu_supports("sse2");
+            default:
+                return true;
+            }
+#else
+            return isa == ISA::SCALAR;
+#endif
+        }
+
+        inline Kernels make_kernels(const ISA isa) {
+            switch (isa) {
+#ifdef FASTGREP_X86
+            case ISA::AVX512:
+                return Kernels{isa, avx512::find_char, avx512::count, avx512::find, avx512::bitmap,
+                               avx512::popcount};
+            case ISA::AVX2:
+                return Kernels{isa, avx2::find_char, avx2::count, avx2::find, avx2::bitmap, avx2::popcount};
+            case ISA::SSE2:
+                return Kernels{isa, sse2::find_char, sse2::count, sse2::find, sse2::bitmap, sse2::popcount};
+#endif
+            default:
+                return Kernels{ISA::SCALAR, scalar::find_char, scalar::count, scalar::find, scalar::bitmap,
+                               scalar::popcount};
+            }
+        }
+
+        // Select the best supported instruction set which is not above the one given by FASTGREP_SIMD.
+        inline ISA select_isa() {
+            ISA max_isa = ISA::AVX512;
+            const char *env = getenv("FASTGREP_SIMD");
+            if (env != nullptr) {
+                const std::string value(env);
+                if (value == "scalar") max_isa = ISA::SCALAR;
+                if (value == "sse2") max_isa = ISA::SSE2;
+                if (value == "avx2") max_isa = ISA::AVX2;
+            }
+            for (const ISA isa : {ISA::AVX512, ISA::AVX2, ISA::SSE2}) {
+                if ((isa <= max_isa) && is_supported(isa)) return isa;
+            }
+            return ISA::SCALAR;
+        }
+
+        inline const Kernels &kernels() {
+            static const Kernels results = make_kernels(select_isa());
+            return results;
+        }
+
+        inline const char *find_char(const char *begin, const char *end, const char c) {
+            return kernels().find_char(begin, end, c);
+        }
+
+        inline size_t count(const char *begin, const char *end, const char c) {
+            return kernels().count(begin, end, c);
+        }
+
+        // Find the first occurrence of a needle.
+        inline const char *find(const char *begin, const char *end, const char *needle, const size_t len) {
+            if (len == 0) return begin;
+            if (len == 1) return find_char(begin, end, needle[0]);
+            return kernels().find(begin, end, needle, len);
+        }
+
+        inline void bitmap(const char *begin, const char *end, const char c, uint64_t *bits) {
+            kernels().bitmap(begin, end, c, bits);
+        }
+
+        inline size_t popcount(const uint64_t *words, const size_t n, const uint64_t first_mask,
+                               const uint64_t last_mask) {
+            return kernels().popcount(words, n, first_mask, last_mask);
+        }
+    } // namespace simd
+} // namespace fastgrep
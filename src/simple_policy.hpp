@@ -2,7 +2,9 @@
 
 #include "constants.hpp"
 #include "output.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
+#include <cstring>
 #include <string>
 
 namespace fastgrep {
@@ -16,21 +18,27 @@ namespace fastgrep {
         template <typename Params>
         SimplePolicy(const std::string &patt, Params &&params)
             : matcher(patt, params.regex_mode), lines(1), pos(0), console(), linenum(params.linenum()),
-              color(params.color()) {}
+              color(params.color()), quite(params.quite()), files_with_matches(params.files_with_matches()),
+              max_count((quite || files_with_matches) ? 1 : params.max_count) {}
 
         void process(const char *begin, const size_t len) {
             const char *start = begin;
             const char *end = begin + len;
             const char *ptr = begin;
-            while ((ptr = static_cast<const char *>(memchr(ptr, EOL, end - ptr)))) {
+            while ((ptr = simd::find_char(ptr, end, EOL))) {
                 process_line(start, ptr - start + 1);
                 start = ++ptr;
                 ++lines;
+                if (is_done()) {
+                    console.flush();
+                    return;
+                }
             }
 
             // Update the line buffer with leftover data.
             if (start < end) { process_line(start, end - start); }
             pos += len;
+            console.flush();
         }
 
         void reset() {
@@ -38,6 +46,14 @@ namespace fastgrep {
             pos = 0;
         }
 
+        Console &get_console() { return console; }
+
+        // Return true if we do not need to search the current file anymore.
+        bool is_done() const { return (max_count > 0) && (matches >= max_count); }
+
+        // The total number of matched lines in all searched files.
+        size_t number_of_matches() const { return total_matches; }
+
       protected:
         Matcher matcher;
         size_t lines = 1;
@@ -46,15 +62,32 @@ namespace fastgrep {
         Console console;
         bool linenum;
         bool color;
-        const char *file;
+        bool quite;
+        bool files_with_matches;
+        size_t max_count;
+        size_t matches = 0;
+        size_t total_matches = 0;
+        const char *file = nullptr;
 
         // Set the file name so we can display our results better.
         void set_filename(const char *fname) {
             file = fname;
+            lines = 1;
+            pos = 0;
+            matches = 0;
         }
 
         virtual void process_line(const char *begin, const size_t len) {
             if (matcher.is_matched(begin, len)) {
+                ++matches;
+                ++total_matches;
+                if (quite) return;
+                if (files_with_matches) {
+                    const char *fname = file ? file : "(standard input)";
+                    console.print_plain_text(fname, fname + strlen(fname));
+                    return;
+                }
+
                 const size_t buflen = len - 1;
                 if (linenum) {
                     if (!color) {
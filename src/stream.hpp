@@ -2,11 +2,14 @@
 
 #include "constants.hpp"
 #include "fmt/format.h"
+#include "line_index.hpp"
 #include "output.hpp"
+#include "scanners.hpp"
 #include "utils.hpp"
 #include "utils/memchr.hpp"
 #include <cstring>
 #include <string>
+#include <vector>
 
 namespace fastgrep {
     // Note: Stream means data are read by chunks and we do not know when it will be ended.
@@ -15,18 +18,28 @@ namespace fastgrep {
         template <typename Params>
         StreamPolicy(const std::string &patt, Params &&params)
             : matcher(patt, params.regex_mode), lines(1), pos(0), linebuf(), console(),
-              color(params.color()), linenum(params.linenum()) {}
+              color(params.color()), linenum(params.linenum()), quite(params.quite()),
+              files_with_matches(params.files_with_matches()),
+              max_count((quite || files_with_matches) ? 1 : params.max_count),
+              before_context((quite || files_with_matches) ? 0 : params.before_context),
+              after_context((quite || files_with_matches) ? 0 : params.after_context),
+              context(before_context), has_context((before_context + after_context) > 0) {}
 
         void process(const char *begin, const size_t len) {
             const char *start = begin;
             const char *end = begin + len;
             const char *ptr = begin;
-            while ((ptr = static_cast<const char *>(memchr(ptr, EOL, end - ptr)))) {
+            index.build(begin, end);
+            while (true) {
+                if (linebuf.empty()) start = ptr = skip(start, end, can_skip<Matcher>());
+                if ((ptr = index.next(ptr)) == nullptr) break;
                 if (linebuf.empty()) {
                     process_line(start, ptr - start + 1);
                 } else {
                     linebuf.append(start, ptr - start + 1);
                     process_line(linebuf.data(), linebuf.size());
+                    console.flush();
+                    if (has_context) save_context();
                     linebuf.clear();
                 }
 
@@ -34,57 +47,205 @@ namespace fastgrep {
                 start = ++ptr;
                 ++lines;
 
-                // Stop if we reach the end of the buffer.
-                if (ptr >= end) break;
+                // Stop if we have found enough matched lines or we reach the end of the buffer.
+                if (is_done() || (ptr >= end)) break;
             }
 
             // Update the line buffer with leftover data.
             if (ptr == nullptr) { linebuf.append(start, end - start); }
             pos += len;
+            console.flush();
+            if (has_context) save_context();
         }
 
+        Console &get_console() { return console; }
+
+        // Return true if we do not need to search the current file anymore. We still need to print the
+        // trailing context of the last match.
+        bool is_done() const { return (max_count > 0) && (matches >= max_count) && (after_lines == 0); }
+
+        // The total number of matched lines in all searched files.
+        size_t number_of_matches() const { return total_matches; }
+
       protected:
         Matcher matcher;
+        LineIndex index;
         size_t lines = 1;
         size_t pos = 0;
         std::string linebuf;
         Console console;
         bool color = false;
         bool linenum = false;
+        bool quite = false;
+        bool files_with_matches = false;
+        size_t max_count = 0;
+        size_t matches = 0;
+        size_t total_matches = 0;
         const char *file = nullptr;
 
+        // A context line points to the current buffer and it is only copied to its own buffer when the
+        // current buffer is invalidated.
+        struct ContextLine {
+            const char *begin;
+            size_t len;
+            size_t linenum;
+            std::string buffer;
+        };
+
+        // Context lines are stored in a ring buffer which has before_context lines.
+        size_t before_context = 0;
+        size_t after_context = 0;
+        std::vector<ContextLine> context;
+        size_t context_begin = 0;
+        size_t context_size = 0;
+        size_t after_lines = 0;   // The number of lines after the last match which need to be printed.
+        size_t last_printed = 0;  // The line number of the last printed line.
+        bool has_context = false;
+
+        // Jump to the next candidate line if the matcher can search the whole buffer. The numbers of the
+        // skipped lines are computed with popcount and only the last before_context lines are kept as
+        // context, so line numbers and context lines do not force us to look at every line.
+        const char *skip(const char *start, const char *end, std::true_type) {
+            if ((after_lines > 0) || (start >= end)) return start;
+            const char *match_end = matcher.find(start, end);
+            const char *target = nullptr;
+            if (match_end != nullptr) {
+                const char *last_char = (match_end > start) ? match_end - 1 : start;
+                target = index.prev(last_char);
+            } else {
+                target = index.prev(end);
+            }
+            target = ((target == nullptr) || (target < start)) ? start : target + 1;
+
+            // Find the first context line then add all context lines to the ring buffer.
+            const char *first = target;
+            for (size_t count = 0; (count < before_context) && (first > start); ++count) {
+                const char *eol = index.prev(first - 1);
+                first = ((eol == nullptr) || (eol < start)) ? start : eol + 1;
+            }
+            lines += index.count(start, first);
+            while (first < target) {
+                const char *eol = index.next(first);
+                add_context(first, eol - first, lines++);
+                first = eol + 1;
+            }
+            return target;
+        }
+
+        const char *skip(const char *start, const char *, std::false_type) { return start; }
+
         virtual void process_line(const char *begin, const size_t len) {
-            if (matcher.is_matched(begin, len)) {
-                const size_t buflen = len - 1;
-                if (!linenum) {
-                    if (!color) {
-                        if (file) { fmt::print("{}:", file); }
-                        console.print_plain_text(begin, begin + buflen);
-                    } else {
-                        if (file) { fmt::print("\033[1;34m{}:", file); }
-                        console.print_color_text(begin, begin + buflen);
-                    }
+            if (((max_count == 0) || (matches < max_count)) && matcher.is_matched(begin, len)) {
+                ++matches;
+                ++total_matches;
+                if (quite) return;
+                if (files_with_matches) {
+                    const char *fname = file ? file : "(standard input)";
+                    console.print_plain_text(fname, fname + strlen(fname));
+                    return;
+                }
+
+                if (has_context) {
+                    print_context();
+                    after_lines = after_context;
+                }
+                print_line(begin, len - 1, lines);
+            } else if (after_lines > 0) {
+                print_line(begin, len - 1, lines);
+                --after_lines;
+            } else if (before_context > 0) {
+                add_context(begin, len - 1, lines);
+            }
+        }
+
+        void print_line(const char *begin, const size_t len, const size_t lineno) {
+            // Print a separator between two groups of lines.
+            if (has_context) {
+                if ((last_printed > 0) && (lineno > last_printed + 1)) {
+                    console.print_plain_text(SEPARATOR, SEPARATOR + 2);
+                }
+                last_printed = lineno;
+            }
+
+            if (!linenum) {
+                if (!color) {
+                    if (file) { console.print_filename(file); }
+                    console.print_plain_text(begin, begin + len);
                 } else {
-                    if (!color) {
-                        if (file) { fmt::print("{}:", file); }
-                        console.print_plain_text(begin, begin + buflen, lines);
-                    } else {
-                        if (file) { fmt::print("\033[1;34m{}:", file); }
-                        console.print_color_text(begin, begin + buflen, lines);
-                    }
+                    if (file) { console.print_color_filename(file); }
+                    console.print_color_text(begin, begin + len);
                 }
+            } else {
+                if (!color) {
+                    if (file) { console.print_filename(file); }
+                    console.print_plain_text(begin, begin + len, lineno);
+                } else {
+                    if (file) { console.print_color_filename(file); }
+                    console.print_color_text(begin, begin + len, lineno);
+                }
+            }
+        }
+
+        // Add a line to the ring buffer. The oldest line is dropped if the ring buffer is full.
+        void add_context(const char *begin, const size_t len, const size_t lineno) {
+            size_t idx;
+            if (context_size < before_context) {
+                idx = (context_begin + context_size) % before_context;
+                ++context_size;
+            } else {
+                idx = context_begin;
+                context_begin = (context_begin + 1) % before_context;
+            }
+            auto &aline = context[idx];
+            aline.begin = begin;
+            aline.len = len;
+            aline.linenum = lineno;
+        }
+
+        // Print all lines before a matched line. Lines which have been printed are skipped.
+        void print_context() {
+            for (size_t count = 0; count < context_size; ++count) {
+                auto const &aline = context[(context_begin + count) % before_context];
+                if (aline.linenum > last_printed) print_line(aline.begin, aline.len, aline.linenum);
             }
+            context_begin = 0;
+            context_size = 0;
         }
 
-        // Set the file name so we can display our results better.
+        // Copy context lines to their own buffers because the current buffer will be invalidated. This
+        // method must be called after the console is flushed.
+        void save_context() {
+            for (size_t count = 0; count < context_size; ++count) {
+                auto &aline = context[(context_begin + count) % before_context];
+                if (aline.begin != aline.buffer.data()) {
+                    aline.buffer.assign(aline.begin, aline.len);
+                    aline.begin = aline.buffer.data();
+                }
+            }
+        }
+
+        // Set the file name so we can display our results better. This method is called before we search
+        // a new file so we also reset all per-file states.
         void set_filename(const char *fname) {
             file = fname;
+            linebuf.clear();
+            lines = 1;
+            pos = 0;
+            matches = 0;
+            context_begin = 0;
+            context_size = 0;
+            after_lines = 0;
+            last_printed = 0;
         }
 
-        // Process text data in the linebuf.
+        // Process text data in the linebuf. The EOL is added so the last character of the line is kept.
         void finalize() {
-            process_line(linebuf.data(), linebuf.size());
-            linebuf.clear();
+            if (!linebuf.empty()) {
+                linebuf.push_back(EOL);
+                process_line(linebuf.data(), linebuf.size());
+                console.flush();
+                linebuf.clear();
+            }
             lines = 1;
             pos = 0;
         }
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "constants.hpp"
+#include "timestamp.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unistd.h>
+#include <vector>
+
+namespace fastgrep {
+    // The byte range [begin, end) of the lines of a file in a time window.
+    struct TimeRange {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    // TimeSeeker finds lines by timestamp in log files which are sorted by time, for example scribe logs
+    // which are append-only. It binary searches the file by byte offset: the first line starting at or
+    // after an offset is found by reading a small window, and lines which do not start with a timestamp,
+    // e.g. the continuation lines of a message, belong to the previous message. Only O(log(size)) windows
+    // are read so finding a few minutes of a daily log does not depend on its size.
+    class TimeSeeker {
+      public:
+        static constexpr size_t WINDOW_SIZE = 1 << 12;
+
+        TimeSeeker(const int fd, const size_t size) : fd(fd), size(size), window(WINDOW_SIZE) {}
+
+        // Return the offset of the first message whose timestamp is not less than value, or the file
+        // size if there is no such message.
+        size_t lower_bound(const int64_t value) {
+            size_t lo = 0, hi = size;
+            size_t pos;
+            int64_t timestamp;
+            while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (!next_message(mid, pos, timestamp) || (timestamp >= value)) {
+                    hi = mid;
+                } else {
+                    lo = pos + 1; // All offsets in [mid, pos] lead to the same message.
+                }
+            }
+            return next_message(lo, pos, timestamp) ? pos : size;
+        }
+
+        // Find the lines whose timestamps are in [begin, end]. The range is empty if end < begin.
+        TimeRange find(const int64_t begin, const int64_t end) {
+            TimeRange range;
+            range.begin = (begin == std::numeric_limits<int64_t>::min()) ? 0 : lower_bound(begin);
+            range.end = (end == std::numeric_limits<int64_t>::max()) ? size : lower_bound(end + 1);
+            range.end = std::max(range.begin, range.end);
+            return range;
+        }
+
+      private:
+        int fd;
+        size_t size;
+        std::vector<char> window;
+
+        // Find the first line which starts at or after offset and has a timestamp.
+        bool next_message(const size_t offset, size_t &pos, int64_t &value) {
+            pos = offset;
+            if ((pos > 0) && !next_line(pos - 1, pos)) return false;
+            while (pos < size) {
+                const size_t len = read(pos);
+                if (len == 0) return false;
+                if (timestamp::parse(window.data(), window.data() + len, value)) return true;
+                const char *eol = static_cast<const char *>(memchr(window.data(), EOL, len));
+                if (eol != nullptr) {
+                    pos += eol - window.data() + 1;
+                } else if (!next_line(pos + len, pos)) {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        // Find the beginning of the line after the first EOL at or after offset.
+        bool next_line(size_t offset, size_t &pos) {
+            while (offset < size) {
+                const size_t len = read(offset);
+                if (len == 0) return false;
+                const char *eol = static_cast<const char *>(memchr(window.data(), EOL, len));
+                if (eol != nullptr) {
+                    pos = offset + (eol - window.data()) + 1;
+                    return true;
+                }
+                offset += len;
+            }
+            return false;
+        }
+
+        // Read a window at offset. Return the number of read bytes.
+        size_t read(const size_t offset) {
+            const size_t len = std::min(window.size(), size - offset);
+            ssize_t nbytes;
+            do {
+                nbytes = ::pread(fd, window.data(), len, offset);
+            } while ((nbytes < 0) && (errno == EINTR));
+            return (nbytes < 0) ? 0 : nbytes;
+        }
+    };
+
+    // Find the lines of a sorted log file whose timestamps are in [begin, end].
+    inline TimeRange find_time_range(const int fd, const size_t size, const int64_t begin,
+                                     const int64_t end) {
+        return TimeSeeker(fd, size).find(begin, end);
+    }
+} // namespace fastgrep
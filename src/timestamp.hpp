@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fastgrep {
+    // Parse the timestamps at the beginning of log lines. Scribe logs use "mm-dd-yyyy hh:mm:ss" and we
+    // also accept "yyyy-mm-dd hh:mm:ss" or "yyyy-mm-ddThh:mm:ss". Timestamps are converted to the number
+    // of seconds since the epoch without any time zone adjustment so they can be compared.
+    namespace timestamp {
+        constexpr size_t TIMESTAMP_LENGTH = 19;
+
+        // Return the number of days since 1970-01-01 of a date in the proleptic Gregorian calendar.
+        inline int64_t days_from_civil(int64_t year, const unsigned month, const unsigned day) {
+            year -= month <= 2;
+            const int64_t era = (year >= 0 ? year : year - 399) / 400;
+            const unsigned yoe = static_cast<unsigned>(year - era * 400);
+            const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+            const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146097 + static_cast<int64_t>(doe) - 719468;
+        }
+
+        // Return the date of a number of days since 1970-01-01. This is the inverse of days_from_civil.
+        inline void civil_from_days(int64_t days, int64_t &year, unsigned &month, unsigned &day) {
+            days += 719468;
+            const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+            const unsigned doe = static_cast<unsigned>(days - era * 146097);
+            const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            const unsigned mp = (5 * doy + 2) / 153;
+            day = doy - (153 * mp + 2) / 5 + 1;
+            month = (mp < 10) ? mp + 3 : mp - 9;
+            year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+        }
+
+        // Parse n digits. Return false if any of them is not a digit.
+        inline bool parse_digits(const char *ptr, const size_t n, unsigned &value) {
+            value = 0;
+            for (size_t idx = 0; idx < n; ++idx) {
+                const unsigned digit = static_cast<unsigned char>(ptr[idx]) - '0';
+                if (digit > 9) return false;
+                value = value * 10 + digit;
+            }
+            return true;
+        }
+
+        inline bool is_valid(const unsigned month, const unsigned day, const unsigned hour,
+                             const unsigned minute, const unsigned second) {
+            return (month >= 1) && (month <= 12) && (day >= 1) && (day <= 31) && (hour <= 23) &&
+                   (minute <= 59) && (second <= 60);
+        }
+
+        inline int64_t to_seconds(const unsigned year, const unsigned month, const unsigned day,
+                                  const unsigned hour, const unsigned minute, const unsigned second) {
+            return days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+        }
+
+        // Parse a timestamp which starts at begin. Return false if [begin, end) does not start with a
+        // valid timestamp.
+        inline bool parse_scalar(const char *begin, const char *end, int64_t &value) {
+            if (end - begin < static_cast<ptrdiff_t>(TIMESTAMP_LENGTH)) return false;
+            unsigned year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+            bool is_ok;
+            if ((begin[4] == '-') && (begin[7] == '-')) {
+                is_ok = parse_digits(begin, 4, year) && parse_digits(begin + 5, 2, month) &&
+                        parse_digits(begin + 8, 2, day);
+            } else if (((begin[2] == '-') || (begin[2] == '/')) && (begin[5] == begin[2])) {
+                is_ok = parse_digits(begin, 2, month) && parse_digits(begin + 3, 2, day) &&
+                        parse_digits(begin + 6, 4, year);
+            } else {
+                return false;
+            }
+            is_ok = is_ok && ((begin[10] == ' ') || (begin[10] == 'T')) && (begin[13] == ':') &&
+                    (begin[16] == ':') && parse_digits(begin + 11, 2, hour) &&
+                    parse_digits(begin + 14, 2, minute) && parse_digits(begin + 17, 2, second);
+            if (!is_ok || !is_valid(month, day, hour, minute, second)) return false;
+            value = to_seconds(year, month, day, hour, minute, second);
+            return true;
+        }
+
+#ifdef __SSE2__
+        // Parse a scribe timestamp, i.e "mm-dd-yyyy hh:mm:ss", using one 16 byte load. The 16 bytes after
+        // the month are converted to 16-bit digits, their separators and digits are validated using byte
+        // comparisons, and pmaddwd combines the digits of each field using their decimal weights:
+        //     position: d d - y y y y _ h h : m m : s s
+        //     weight:   10 1 0 1000 100 10 1 0 10 1 0 10 1 0 10 1
+        // so the 32-bit sums are day, the three parts of year, hour, the two parts of minute, and second.
+        // Return false if the layout does not match so callers can use the scalar parser.
+        inline bool parse_sse2(const char *begin, int64_t &value) {
+            const unsigned month = (begin[0] - '0') * 10u + (begin[1] - '0');
+            if ((begin[2] != '-') || (static_cast<unsigned char>(begin[0] - '0') > 9) ||
+                (static_cast<unsigned char>(begin[1] - '0') > 9)) {
+                return false;
+            }
+
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 3));
+            const __m128i digits = _mm_sub_epi8(data, _mm_set1_epi8('0'));
+            const __m128i nine = _mm_set1_epi8(9);
+            const __m128i is_digit = _mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine);
+            const __m128i separators =
+                _mm_setr_epi8(0, 0, '-', 0, 0, 0, 0, ' ', 0, 0, ':', 0, 0, ':', 0, 0);
+            const __m128i other_separators =
+                _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 'T', 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i is_separator = _mm_or_si128(_mm_cmpeq_epi8(data, separators),
+                                                      _mm_cmpeq_epi8(data, other_separators));
+            const int separator_mask = (1 << 2) | (1 << 7) | (1 << 10) | (1 << 13);
+            const int mask = (_mm_movemask_epi8(is_digit) & ~separator_mask) |
+                             (_mm_movemask_epi8(is_separator) & separator_mask);
+            if (mask != 0xffff) return false;
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(digits, zero),
+                                               _mm_setr_epi16(10, 1, 0, 1000, 100, 10, 1, 0));
+            const __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(digits, zero),
+                                                _mm_setr_epi16(10, 1, 0, 10, 1, 0, 10, 1));
+            alignas(16) uint32_t fields[8];
+            _mm_store_si128(reinterpret_cast<__m128i *>(fields), low);
+            _mm_store_si128(reinterpret_cast<__m128i *>(fields + 4), high);
+            const unsigned day = fields[0];
+            const unsigned year = fields[1] + fields[2] + fields[3];
+            const unsigned hour = fields[4];
+            const unsigned minute = fields[5] + fields[6];
+            const unsigned second = fields[7];
+            if (!is_valid(month, day, hour, minute, second)) return false;
+            value = to_seconds(year, month, day, hour, minute, second);
+            return true;
+        }
+#endif
+
+        // Parse a timestamp which starts at begin. Return false if [begin, end) does not start with a
+        // valid timestamp. Scribe timestamps are parsed using SIMD and the other formats use the scalar
+        // parser.
+        inline bool parse(const char *begin, const char *end, int64_t &value) {
+            if (end - begin < static_cast<ptrdiff_t>(TIMESTAMP_LENGTH)) return false;
+#ifdef __SSE2__
+            if (parse_sse2(begin, value)) return true;
+#endif
+            return parse_scalar(begin, end, value);
+        }
+
+        // Parse a timestamp given by users.
+        inline int64_t parse(const std::string &timestr) {
+            int64_t value = 0;
+            const char *begin = timestr.data();
+            if ((timestr.size() != TIMESTAMP_LENGTH) || !parse(begin, begin + timestr.size(), value)) {
+                throw std::runtime_error("Invalid time string: " + timestr);
+            }
+            return value;
+        }
+
+        // Format a number of seconds since the epoch as a scribe timestamp, i.e "mm-dd-yyyy hh:mm:ss".
+        inline std::string format(const int64_t value) {
+            int64_t days = value / 86400;
+            int64_t seconds = value % 86400;
+            if (seconds < 0) {
+                seconds += 86400;
+                --days;
+            }
+            int64_t year;
+            unsigned month, day;
+            civil_from_days(days, year, month, day);
+            char buffer[48];
+            snprintf(buffer, sizeof(buffer), "%02u-%02u-%04lld %02lld:%02lld:%02lld", month, day,
+                     static_cast<long long>(year), static_cast<long long>(seconds / 3600),
+                     static_cast<long long>(seconds / 60 % 60), static_cast<long long>(seconds % 60));
+            return buffer;
+        }
+    } // namespace timestamp
+} // namespace fastgrep
@@ -0,0 +1,416 @@
+#pragma once
+
+#include "constants.hpp"
+#include "reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define FASTGREP_USE_IO_URING
+#endif
+#endif
+
+namespace fastgrep {
+    namespace uring {
+#ifdef FASTGREP_USE_IO_URING
+        // A minimal io_uring wrapper which uses the raw system calls so we do not depend on liburing. A
+        // ring is invalid if the kernel does not support io_uring or the operations used by UringReader.
+        class Ring {
+          public:
+            explicit Ring(const unsigned entries) {
+                struct io_uring_params params;
+                memset(&params, 0, sizeof(params));
+                fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                if (fd < 0) return;
+                const bool is_ok =
+                    map_rings(params) && is_supported({IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE});
+                if (!is_ok) release();
+            }
+
+            Ring(const Ring &) = delete;
+            Ring &operator=(const Ring &) = delete;
+
+            ~Ring() { release(); }
+
+            bool is_valid() const { return fd >= 0; }
+
+            // Return nullptr if the submission queue is full.
+            struct io_uring_sqe *get_sqe() {
+                const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+                if (sqe_tail - head >= sq_entries) return nullptr;
+                struct io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+                sq_array[sqe_tail & sq_mask] = sqe_tail & sq_mask;
+                ++sqe_tail;
+                memset(sqe, 0, sizeof(*sqe));
+                return sqe;
+            }
+
+            // Submit all queued requests and wait for at least wait_nr completions. The kernel might
+            // consume fewer requests than given, in which case it does not wait, so we submit the rest
+            // again until all of them have been consumed.
+            void submit(const unsigned wait_nr) {
+                __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+                unsigned to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+                const unsigned flags = (wait_nr > 0) ? IORING_ENTER_GETEVENTS : 0;
+                while (true) {
+                    const long ret =
+                        syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, flags, nullptr, 0);
+                    if (ret < 0) {
+                        if (errno == EINTR) continue;
+                        throw std::runtime_error(std::string("io_uring_enter: ") + strerror(errno));
+                    }
+                    const unsigned nsubmitted = static_cast<unsigned>(ret);
+                    if (nsubmitted >= to_submit) return;
+                    if (nsubmitted == 0) {
+                        throw std::runtime_error("io_uring_enter: no request was submitted");
+                    }
+                    to_submit -= nsubmitted;
+                }
+            }
+
+            // Return false if there is no completed request.
+            bool pop(struct io_uring_cqe &cqe) {
+                const unsigned head = *cq_head;
+                if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+                cqe = cqes[head & cq_mask];
+                __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+
+          private:
+            int fd = -1;
+            void *sq_ptr = MAP_FAILED;
+            void *cq_ptr = MAP_FAILED;
+            size_t sq_size = 0;
+            size_t cq_size = 0;
+            struct io_uring_sqe *sqes = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+            size_t sqes_size = 0;
+
+            unsigned *sq_head = nullptr;
+            unsigned *sq_tail = nullptr;
+            unsigned *sq_array = nullptr;
+            unsigned sq_mask = 0;
+            unsigned sq_entries = 0;
+            unsigned sqe_tail = 0;
+
+            unsigned *cq_head = nullptr;
+            unsigned *cq_tail = nullptr;
+            struct io_uring_cqe *cqes = nullptr;
+            unsigned cq_mask = 0;
+
+            bool map_rings(const struct io_uring_params &params) {
+                sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+                const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single_mmap) sq_size = cq_size = std::max(sq_size, cq_size);
+
+                const int prot = PROT_READ | PROT_WRITE;
+                const int flags = MAP_SHARED | MAP_POPULATE;
+                sq_ptr = mmap(nullptr, sq_size, prot, flags, fd, IORING_OFF_SQ_RING);
+                if (sq_ptr == MAP_FAILED) return false;
+                if (!single_mmap) {
+                    cq_ptr = mmap(nullptr, cq_size, prot, flags, fd, IORING_OFF_CQ_RING);
+                    if (cq_ptr == MAP_FAILED) return false;
+                }
+                sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+                void *ptr = mmap(nullptr, sqes_size, prot, flags, fd, IORING_OFF_SQES);
+                if (ptr == MAP_FAILED) return false;
+                sqes = static_cast<struct io_uring_sqe *>(ptr);
+
+                char *sq = static_cast<char *>(sq_ptr);
+                char *cq = static_cast<char *>(single_mmap ? sq_ptr : cq_ptr);
+                sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+                sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+                sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+                sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+                sq_entries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+                sqe_tail = *sq_tail;
+                cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+                cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+                cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+                cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+                return true;
+            }
+
+            // Check the given operations using IORING_REGISTER_PROBE which is available since Linux 5.6.
+            bool is_supported(std::initializer_list<unsigned> ops) const {
+                constexpr size_t NOPS = 256;
+                const size_t size = sizeof(struct io_uring_probe) + NOPS * sizeof(struct io_uring_probe_op);
+                std::vector<char> buffer(size);
+                auto probe = reinterpret_cast<struct io_uring_probe *>(buffer.data());
+                if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, NOPS) < 0) {
+                    return false;
+                }
+                for (const unsigned op : ops) {
+                    if (op >= probe->ops_len) return false;
+                    if (!(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+                }
+                return true;
+            }
+
+            void release() {
+                if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+                if (cq_ptr != MAP_FAILED) munmap(cq_ptr, cq_size);
+                if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+                sqes = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+                cq_ptr = sq_ptr = MAP_FAILED;
+                if (fd >= 0) ::close(fd);
+                fd = -1;
+            }
+        };
+#else
+        // io_uring is not available so UringReader always uses the synchronous reader.
+        class Ring {
+          public:
+            explicit Ring(const unsigned) {}
+            bool is_valid() const { return false; }
+        };
+#endif
+    } // namespace uring
+
+    // UringReader searches many small files using io_uring. It keeps up to QUEUE_DEPTH files in flight,
+    // their open and read requests are submitted in batches so a system call serves many files, and the
+    // content of a file is given to the policy once it has been read completely. Files are searched in
+    // the order they are given so the output is the same as FileReader's output. Slot buffers are at most
+    // MAX_SLOT_SIZE bytes so the memory usage of a thread is small, and a file which is bigger than a slot
+    // buffer is searched using FileReader. The synchronous reader is also used if the kernel does not
+    // support io_uring, users select an I/O method, or users search a time window.
+    template <typename Policy> class UringReader : public FileReader<Policy> {
+      public:
+        static constexpr unsigned QUEUE_DEPTH = 64;
+        static constexpr size_t MAX_SLOT_SIZE = 1 << 16;
+
+        template <typename... Args>
+        UringReader(Args &&... args)
+            : FileReader<Policy>(std::forward<Args>(args)...), ring(2 * QUEUE_DEPTH) {}
+
+        // Search all tasks returned by next. The done callback is called after a task has been searched
+        // and it is called in the same order as next.
+        template <typename Task, typename Next, typename Done> void run(Next &&next, Done &&done) {
+            run<Task>(next, done, []() { return false; });
+        }
+
+        // Search tasks until stop returns true e.g we only need the first match. Files which have been
+        // opened but not searched yet are skipped and done is not called for them.
+        template <typename Task, typename Next, typename Done, typename Stop>
+        void run(Next &&next, Done &&done, Stop &&stop) {
+#ifdef FASTGREP_USE_IO_URING
+            if (ring.is_valid() && this->adaptive && !this->use_time_range) {
+                search_all<Task>(next, done, stop);
+                return;
+            }
+#endif
+            Task task;
+            while (!stop() && next(task)) {
+                (*this)(task.path.data());
+                done(task);
+            }
+        }
+
+      private:
+        uring::Ring ring;
+
+#ifdef FASTGREP_USE_IO_URING
+        static constexpr __u64 CLOSE_REQUEST = ~__u64(0);
+
+        enum class State { OPEN, READ, DONE, BIG, FAILED };
+
+        template <typename Task> struct Slot {
+            Task task;
+            State state = State::OPEN;
+            int fd = -1;
+            int error = 0;
+            size_t size = 0;
+            std::vector<char> data;
+        };
+
+        template <typename Task, typename Next, typename Done, typename Stop>
+        void search_all(Next &next, Done &done, Stop &stop) {
+            std::vector<Slot<Task>> slots(QUEUE_DEPTH);
+            const size_t capacity =
+                std::min(std::max<size_t>(this->read_size, 1 << 12), static_cast<size_t>(MAX_SLOT_SIZE));
+            size_t head = 0, count = 0;
+            bool has_tasks = true;
+            bool stopped = false;
+            while (true) {
+                // Pending requests still use their slots so we wait for them after the search is stopped.
+                if (!stopped && stop()) {
+                    stopped = true;
+                    has_tasks = false;
+                }
+
+                // Start searching new files.
+                while (has_tasks && (count < QUEUE_DEPTH)) {
+                    Slot<Task> &slot = slots[(head + count) % QUEUE_DEPTH];
+                    if (!next(slot.task)) {
+                        has_tasks = false;
+                        break;
+                    }
+                    slot.state = State::OPEN;
+                    slot.fd = -1;
+                    slot.error = 0;
+                    slot.size = 0;
+                    // One more byte tells us that a file is bigger than capacity and the last byte is used
+                    // for the EOL of the last line.
+                    slot.data.resize(capacity + 2);
+                    submit_open(slot, (head + count) % QUEUE_DEPTH);
+                    ++count;
+                }
+                if (count == 0) break;
+
+                // Search finished files in order.
+                Slot<Task> &first = slots[head];
+                if ((first.state != State::OPEN) && (first.state != State::READ)) {
+                    if (stopped) {
+                        if (first.state == State::BIG) ::close(first.fd);
+                        first.fd = -1;
+                    } else {
+                        finish(first);
+                        done(first.task);
+                    }
+                    head = (head + 1) % QUEUE_DEPTH;
+                    --count;
+                    continue;
+                }
+
+                ring.submit(1);
+                struct io_uring_cqe cqe;
+                while (ring.pop(cqe)) {
+                    if (cqe.user_data == CLOSE_REQUEST) continue;
+                    complete(slots[cqe.user_data], cqe.user_data, cqe.res, stopped);
+                }
+            }
+            ring.submit(0);
+        }
+
+        template <typename S> void submit_open(S &slot, const size_t idx) {
+            struct io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<__u64>(slot.task.path.data());
+            sqe->open_flags = O_RDONLY;
+            sqe->user_data = idx;
+        }
+
+        template <typename S> void submit_read(S &slot, const size_t idx) {
+            struct io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<__u64>(slot.data.data() + slot.size);
+            sqe->len = static_cast<unsigned>(slot.data.size() - 1 - slot.size);
+            sqe->off = slot.size;
+            sqe->user_data = idx;
+        }
+
+        void submit_close(const int fd) {
+            struct io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fd;
+            sqe->user_data = CLOSE_REQUEST;
+        }
+
+        // Each file has at most one pending request and one close request so the submission queue is only
+        // full if requests have not been submitted yet.
+        struct io_uring_sqe *get_sqe() {
+            struct io_uring_sqe *sqe = ring.get_sqe();
+            if (sqe == nullptr) {
+                ring.submit(0);
+                sqe = ring.get_sqe();
+            }
+            return sqe;
+        }
+
+        // Move a file to its next state. A file is read until we get EOF or its slot buffer is full, i.e it
+        // is bigger than capacity, or it is closed as soon as possible if the search has been stopped.
+        template <typename S> void complete(S &slot, const size_t idx, const int res, const bool stopped) {
+            if ((res == -EINTR) || (res == -EAGAIN)) {
+                if (slot.state == State::OPEN) {
+                    submit_open(slot, idx);
+                } else {
+                    submit_read(slot, idx);
+                }
+                return;
+            }
+
+            // The error code is only kept for read errors.
+            if (res < 0) {
+                slot.error = (slot.state == State::OPEN) ? 0 : -res;
+                if (slot.fd >= 0) submit_close(slot.fd);
+                slot.fd = -1;
+                slot.state = State::FAILED;
+                return;
+            }
+
+            if (slot.state == State::OPEN) {
+                slot.fd = res;
+                slot.state = State::READ;
+                if (!stopped) {
+                    submit_read(slot, idx);
+                    return;
+                }
+            }
+
+            if ((res == 0) || stopped) {
+                submit_close(slot.fd);
+                slot.fd = -1;
+                slot.state = State::DONE;
+            } else {
+                slot.size += res;
+                if (slot.size + 1 < slot.data.size()) {
+                    submit_read(slot, idx);
+                } else {
+                    slot.state = State::BIG;
+                }
+            }
+        }
+
+        template <typename S> void finish(S &slot) {
+            const char *datafile = slot.task.path.data();
+            if (slot.state == State::FAILED) {
+                if (slot.error == 0) {
+                    fprintf(stderr, "Cannot open file: %s\n", datafile);
+                } else {
+                    fprintf(stderr, "Cannot read file: %s: %s\n", datafile, strerror(slot.error));
+                }
+            } else if (slot.state == State::BIG) {
+                // The file is still open and its offset is zero because reads use explicit offsets.
+                this->search(slot.fd, datafile);
+                ::close(slot.fd);
+            } else {
+                this->start_file(datafile);
+                process_file(slot.data.data(), slot.size);
+                Policy::finalize();
+            }
+            slot.fd = -1;
+        }
+
+        // Give the content of a file to the policy. The buffer has room for the EOL of the last line.
+        void process_file(char *data, const size_t len) {
+            const char *last = static_cast<const char *>(memrchr(data, EOL, len));
+            size_t nlines = 0;
+            if (last != nullptr) {
+                nlines = last - data + 1;
+                this->process_lines(data, nlines);
+                if (Policy::is_done()) return;
+            }
+            if (nlines < len) {
+                data[len] = EOL;
+                this->process_lines(data + nlines, len - nlines + 1);
+            }
+        }
+#endif
+    };
+} // namespace fastgrep
@@ -0,0 +1,90 @@
+#include "fmt/format.h"
+#include <string>
+
+#include "chunk_reader.hpp"
+#include "constants.hpp"
+#include "inverse_policy.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "reader.hpp"
+#include "scan_policy.hpp"
+#include "scanners.hpp"
+#include "temp_files.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    // Lines of different lengths including empty lines. The last line does not have EOL.
+    std::string generate_data() {
+        std::string data;
+        for (int idx = 0; idx < 1000; ++idx) {
+            if (idx % 11 == 0) {
+                data.push_back(fastgrep::EOL);
+                continue;
+            }
+            data.append(fmt::format("{} {}", idx, std::string(idx % 13, 'x')));
+            if (idx % 7 == 0) data.append(" needle");
+            data.push_back(fastgrep::EOL);
+        }
+        data.append("The last line has a needle but it does not have EOL");
+        return data;
+    }
+
+    template <typename Policy> std::string expected_results(const char *fname, const int info) {
+        fastgrep::Params params;
+        params.info = info;
+        fastgrep::FileReader<Policy> reader("needle", params);
+        reader(fname);
+        return reader.get_console().buffer;
+    }
+
+    template <typename Policy>
+    std::string chunk_results(const char *fname, const int info, const size_t nthreads,
+                              const size_t chunk_size) {
+        fastgrep::Params params;
+        params.info = info;
+        fastgrep::ChunkReader<Policy> reader("needle", params, nthreads, chunk_size);
+        std::string results;
+        reader(fname, [&results](const std::string &data) { results.append(data); });
+        return results;
+    }
+
+    template <typename Policy> void check_chunks(const char *fname) {
+        for (const int info : {0, static_cast<int>(fastgrep::LINENUM)}) {
+            const std::string expected = expected_results<Policy>(fname, info);
+            REQUIRE(!expected.empty());
+            for (const size_t nthreads : {1, 3}) {
+                // Small chunks make most lines cross a chunk boundary.
+                for (const size_t chunk_size : {1, 5, 64, 1 << 20}) {
+                    CHECK(chunk_results<Policy>(fname, info, nthreads, chunk_size) == expected);
+                }
+            }
+        }
+    }
+} // namespace
+
+TEST_CASE("ChunkReader should produce the same results as FileReader") {
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_data());
+
+    SECTION("Matched lines") {
+        check_chunks<fastgrep::ScanPolicy<fastgrep::ExactScanner, fastgrep::StringPolicy>>(fname.data());
+    }
+
+    SECTION("Lines that do not match") {
+        check_chunks<fastgrep::InversePolicy<fastgrep::ExactScanner, fastgrep::StringPolicy>>(fname.data());
+    }
+}
+
+TEST_CASE("Line numbers of chunks") {
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write("a\nneedle 2\n\nb needle 4\nc\nneedle 6");
+    fastgrep::Params params;
+    params.info = fastgrep::LINENUM;
+    using Policy = fastgrep::ScanPolicy<fastgrep::ExactScanner, fastgrep::StringPolicy>;
+    fastgrep::ChunkReader<Policy> reader("needle", params, 2, 3);
+    std::string results;
+    CHECK(reader(fname.data(), [&results](const std::string &data) { results.append(data); }) == 3);
+    CHECK(results == fmt::format("{0}:2:needle 2\n{0}:4:b needle 4\n{0}:6:needle 6\n", fname));
+}
@@ -1,13 +1,57 @@
 #include "fmt/format.h"
+#include <fcntl.h>
 #include <string>
+#include <unistd.h>
 
 #include "constants.hpp"
 #include "ioutils/ioutils.hpp"
 #include "output.hpp"
+#include "temp_files.hpp"
 
 #define CATCH_CONFIG_MAIN
 #include "catch/catch.hpp"
 
+namespace {
+    // Redirect the STDOUT to a temporary file so we can check what is written by a console.
+    class StdoutCapture {
+      public:
+        StdoutCapture() : fname(files.write("")), saved(dup(STDOUT_FILENO)) {
+            REQUIRE(saved >= 0);
+            const int fd = ::open(fname.data(), O_WRONLY | O_TRUNC);
+            REQUIRE(fd >= 0);
+            REQUIRE(dup2(fd, STDOUT_FILENO) >= 0);
+            ::close(fd);
+        }
+
+        ~StdoutCapture() { restore(); }
+
+        // Restore the STDOUT and return the captured data.
+        std::string release() {
+            restore();
+            std::string results;
+            const int fd = ::open(fname.data(), O_RDONLY);
+            REQUIRE(fd >= 0);
+            char buffer[4096];
+            ssize_t nbytes;
+            while ((nbytes = ::read(fd, buffer, sizeof(buffer))) > 0) results.append(buffer, nbytes);
+            ::close(fd);
+            return results;
+        }
+
+      private:
+        fastgrep::test::TempFiles files;
+        std::string fname;
+        int saved;
+
+        void restore() {
+            if (saved < 0) return;
+            dup2(saved, STDOUT_FILENO);
+            ::close(saved);
+            saved = -1;
+        }
+    };
+} // namespace
+
 TEST_CASE("FMTPolicy") {
     fastgrep::FMTPolicy console;
     std::string data("Hello world");
@@ -46,3 +90,43 @@ TEST_CASE("StorePolicy") {
     console.print_plain_text(data.data(), data.data() + data.size());
     REQUIRE(console.lines.size() == 4);
 }
+
+TEST_CASE("WritevPolicy") {
+    const std::string data("Hello world");
+    const unsigned int linenum = 7;
+
+    SECTION("Fewer buffers than the maximum number of iovecs") {
+        StdoutCapture capture;
+        {
+            fastgrep::WritevPolicy console;
+            console.print_filename("foo.txt");
+            console.print_color_text(data.data(), data.data() + data.size(), linenum);
+            console.print_filename("foo.txt");
+            console.print_plain_text(data.data(), data.data() + data.size(), linenum);
+            console.print_color_filename("foo.txt");
+            console.print_color_text(data.data(), data.data() + data.size());
+            console.flush();
+
+            // The destructor writes the pending buffers.
+            console.print_plain_text(data.data(), data.data() + data.size());
+        }
+        CHECK(capture.release() == "foo.txt:\033[1;39m7:\033[1;32mHello world\033[0m\n"
+                                   "foo.txt:7:Hello world\n"
+                                   "\033[1;34mfoo.txt:\033[1;32mHello world\033[0m\n"
+                                   "Hello world\n");
+    }
+
+    SECTION("More buffers than the maximum number of iovecs") {
+        constexpr size_t nlines = 2 * fastgrep::WritevPolicy::MAX_IOVECS;
+        std::string expected;
+        StdoutCapture capture;
+        fastgrep::WritevPolicy console;
+        for (size_t idx = 0; idx < nlines; ++idx) {
+            console.print_filename("foo.txt");
+            console.print_plain_text(data.data(), data.data() + data.size(), idx);
+            expected.append(fmt::format("foo.txt:{}:Hello world\n", idx));
+        }
+        console.flush();
+        CHECK(capture.release() == expected);
+    }
+}
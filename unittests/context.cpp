@@ -0,0 +1,107 @@
+#include "fmt/format.h"
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "scanners.hpp"
+#include "stream.hpp"
+#include "test_policies.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    std::vector<std::string> generate_lines() {
+        std::vector<std::string> lines;
+        for (int idx = 0; idx < 200; ++idx) {
+            std::string aline = fmt::format("{} This is line number {}.", idx, idx);
+            if ((idx % 17 == 0) || (idx % 23 == 0)) aline.append(" It has a needle in it.");
+            lines.emplace_back(std::move(aline));
+        }
+        return lines;
+    }
+
+    // Expected results are computed using the whole file.
+    std::vector<std::string> expected(const std::vector<std::string> &lines, const size_t before,
+                                      const size_t after) {
+        std::vector<bool> selected(lines.size(), false);
+        for (size_t idx = 0; idx < lines.size(); ++idx) {
+            if (lines[idx].find("needle") == std::string::npos) continue;
+            const size_t first = idx > before ? idx - before : 0;
+            const size_t last = std::min(idx + after, lines.size() - 1);
+            for (size_t pos = first; pos <= last; ++pos) selected[pos] = true;
+        }
+
+        std::vector<std::string> results;
+        size_t last_printed = 0;
+        for (size_t idx = 0; idx < lines.size(); ++idx) {
+            if (!selected[idx]) continue;
+            const bool has_context = (before + after) > 0;
+            if (has_context && (last_printed > 0) && (idx > last_printed)) {
+                results.emplace_back(fastgrep::SEPARATOR);
+            }
+            results.push_back(lines[idx]);
+            last_printed = idx + 1;
+        }
+        return results;
+    }
+
+    // This matcher looks at every line because StreamPolicy cannot use it to skip lines.
+    struct LineMatcher : public fastgrep::ScanMatcher<fastgrep::ExactScanner> {
+        using fastgrep::ScanMatcher<fastgrep::ExactScanner>::ScanMatcher;
+    };
+
+    template <typename Matcher = fastgrep::ScanMatcher<fastgrep::ExactScanner>>
+    fastgrep::StorePolicy search(const std::string &data, const size_t before, const size_t after,
+                                 const size_t chunk_size, const int info = 0) {
+        fastgrep::Params params;
+        params.info = info;
+        params.before_context = before;
+        params.after_context = after;
+        using Policy = fastgrep::StreamPolicy<Matcher, fastgrep::StorePolicy>;
+        return fastgrep::test::search_chunks<Policy>("needle", params, data, chunk_size);
+    }
+
+    std::vector<std::string> grep(const std::string &data, const size_t before, const size_t after,
+                                  const size_t chunk_size) {
+        return search(data, before, after, chunk_size).lines;
+    }
+} // namespace
+
+TEST_CASE("StreamPolicy should print context lines") {
+    const auto lines = generate_lines();
+    std::string data;
+    for (auto const &aline : lines) {
+        data.append(aline);
+        data.push_back(fastgrep::EOL);
+    }
+
+    for (auto chunk_size : {1, 13, 64, 1 << 16}) {
+        CHECK(grep(data, 0, 0, chunk_size) == expected(lines, 0, 0));
+        CHECK(grep(data, 3, 3, chunk_size) == expected(lines, 3, 3));
+        CHECK(grep(data, 0, 2, chunk_size) == expected(lines, 0, 2));
+        CHECK(grep(data, 5, 0, chunk_size) == expected(lines, 5, 0));
+        CHECK(grep(data, 10, 1, chunk_size) == expected(lines, 10, 1));
+    }
+}
+
+TEST_CASE("Skipped lines should be counted") {
+    const auto lines = generate_lines();
+    std::string data;
+    for (auto const &aline : lines) {
+        data.append(aline);
+        data.push_back(fastgrep::EOL);
+    }
+
+    for (auto chunk_size : {13, 1 << 16}) {
+        const auto results = search(data, 2, 1, chunk_size, fastgrep::LINENUM);
+        const auto expected_results = search<LineMatcher>(data, 2, 1, chunk_size, fastgrep::LINENUM);
+        CHECK(results.lines == expected_results.lines);
+        CHECK(results.linenums == expected_results.linenums);
+        REQUIRE(results.linenums.size() > 2);
+        CHECK(results.linenums[0] == 1);
+        CHECK(results.linenums[2] == 16);
+    }
+}
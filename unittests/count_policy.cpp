@@ -0,0 +1,45 @@
+#include <string>
+
+#include "constants.hpp"
+#include "count_policy.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "scanners.hpp"
+#include "test_policies.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    const std::string data = "needle needle\n"
+                             "haystack\n"
+                             "a needle in a haystack\n"
+                             "\n"
+                             "the last needle";
+
+    template <typename Scanner>
+    std::vector<std::string> count(const std::string &patt, const int info, const size_t chunk_size,
+                                   const size_t max_count = 0) {
+        fastgrep::Params params;
+        params.info = info;
+        params.max_count = max_count;
+        using Policy = fastgrep::CountPolicy<Scanner, fastgrep::StorePolicy>;
+        return fastgrep::test::search_chunks<Policy>(patt, params, data, chunk_size).lines;
+    }
+} // namespace
+
+TEST_CASE("CountPolicy should count each matched line once") {
+    for (auto chunk_size : {1, 5, 64}) {
+        CHECK(count<fastgrep::ExactScanner>("needle", 0, chunk_size) == std::vector<std::string>{"3"});
+        CHECK(count<fastgrep::hyperscan::Scanner>("need+le", 0, chunk_size) == std::vector<std::string>{"3"});
+        CHECK(count<fastgrep::ExactScanner>("zzz", 0, chunk_size) == std::vector<std::string>{"0"});
+    }
+}
+
+TEST_CASE("CountPolicy with inverse match and max_count") {
+    for (auto chunk_size : {1, 5, 64}) {
+        CHECK(count<fastgrep::ExactScanner>("needle", fastgrep::INVERSE_MATCH, chunk_size) ==
+              std::vector<std::string>{"2"});
+        CHECK(count<fastgrep::ExactScanner>("needle", 0, chunk_size, 2) == std::vector<std::string>{"2"});
+    }
+}
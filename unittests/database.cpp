@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "database.hpp"
+#include "scanners.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    bool is_matched(hs_database_t *database, const std::string &line) {
+        hs_scratch_t *scratch = nullptr;
+        REQUIRE(hs_alloc_scratch(database, &scratch) == HS_SUCCESS);
+        bool found = false;
+        auto handler = [](unsigned int, unsigned long long, unsigned long long, unsigned int, void *ctx) {
+            *static_cast<bool *>(ctx) = true;
+            return 1;
+        };
+        hs_scan(database, line.data(), line.size(), 0, scratch, handler, &found);
+        hs_free_scratch(scratch);
+        return found;
+    }
+} // namespace
+
+TEST_CASE("Compiled databases should be cached") {
+    char folder[] = "/tmp/fastgrep_cacheXXXXXX";
+    REQUIRE(mkdtemp(folder) != nullptr);
+    fastgrep::hyperscan::cache_directory() = folder;
+
+    const std::vector<std::string> patterns = {"foo", "ba+r"};
+    const unsigned int flags = HS_FLAG_DOTALL | HS_FLAG_SINGLEMATCH;
+    const std::string key = fastgrep::hyperscan::cache_key(patterns, flags, HS_MODE_BLOCK);
+    const std::string fname = fastgrep::hyperscan::cache_filename(key);
+
+    // MultiScanner also caches its buffer database.
+    const unsigned int buffer_flags = (flags & ~HS_FLAG_SINGLEMATCH) | HS_FLAG_MULTILINE;
+    const std::string buffer_key = fastgrep::hyperscan::cache_key(patterns, buffer_flags, HS_MODE_BLOCK);
+    const std::string buffer_fname = fastgrep::hyperscan::cache_filename(buffer_key);
+
+    SECTION("A compiled database is saved and it can be loaded") {
+        hs_database_t *database = fastgrep::hyperscan::compile(patterns, flags);
+        CHECK(is_matched(database, "a baaar"));
+        hs_free_database(database);
+
+        database = fastgrep::hyperscan::load_database(fname, key);
+        REQUIRE(database != nullptr);
+        CHECK(is_matched(database, "a baaar"));
+        CHECK(!is_matched(database, "a bz"));
+        hs_free_database(database);
+
+        // A different key must not load this database.
+        const std::string other_key = fastgrep::hyperscan::cache_key(patterns, flags | HS_FLAG_CASELESS,
+                                                                     HS_MODE_BLOCK);
+        CHECK(fastgrep::hyperscan::load_database(fname, other_key) == nullptr);
+    }
+
+    SECTION("Invalid cache files are replaced") {
+        FILE *fp = fopen(fname.c_str(), "wb");
+        REQUIRE(fp != nullptr);
+        fputs("garbage", fp);
+        fclose(fp);
+        CHECK(fastgrep::hyperscan::load_database(fname, key) == nullptr);
+
+        fastgrep::hyperscan::MultiScanner scanner("foo\nba+r", flags);
+        const std::string line = "foo\n";
+        CHECK(scanner.verify(line.data(), line.size()));
+
+        hs_database_t *database = fastgrep::hyperscan::load_database(fname, key);
+        CHECK(database != nullptr);
+        hs_free_database(database);
+
+        database = fastgrep::hyperscan::load_database(buffer_fname, buffer_key);
+        CHECK(database != nullptr);
+        hs_free_database(database);
+    }
+
+    remove(buffer_fname.c_str());
+    remove(fname.c_str());
+    rmdir(folder);
+    fastgrep::hyperscan::cache_directory().clear();
+}
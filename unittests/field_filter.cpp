@@ -0,0 +1,127 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "field_filter.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    fastgrep::FieldConstraints create(const std::vector<std::string> &constraints) {
+        fastgrep::FieldConstraints fields;
+        for (auto const &item : constraints) fields.add(item);
+        return fields;
+    }
+
+    bool is_matched(const fastgrep::FieldConstraints &fields, const std::string &line) {
+        return fields.is_matched(line.data(), line.data() + line.size());
+    }
+
+    std::vector<std::string> filter(fastgrep::FieldConstraints &fields, const std::string &data) {
+        std::vector<std::string> results;
+        auto process = [&results](const char *run, const size_t len) {
+            const char *start = run;
+            const char *last = run + len;
+            while (start < last) {
+                const char *eol = static_cast<const char *>(memchr(start, fastgrep::EOL, last - start));
+                results.emplace_back(start, eol - start);
+                start = eol + 1;
+            }
+        };
+        fields.filter(data.data(), data.data() + data.size(), process);
+        return results;
+    }
+} // namespace
+
+TEST_CASE("SIMD classifier should produce the same masks as the scalar classifier") {
+    std::mt19937 engine(2018);
+    const std::string alphabet = "ab \"\\{}[]:,";
+    std::uniform_int_distribution<size_t> dist(0, alphabet.size() - 1);
+    char data[fastgrep::json::BLOCK_SIZE];
+    for (size_t count = 0; count < 10000; ++count) {
+        for (auto &c : data) c = alphabet[dist(engine)];
+        const fastgrep::json::Masks expected = fastgrep::json::classify_scalar(data);
+        const fastgrep::json::Masks masks = fastgrep::json::classify(data);
+        CHECK(masks.quote == expected.quote);
+        CHECK(masks.backslash == expected.backslash);
+        CHECK(masks.structural == expected.structural);
+    }
+}
+
+TEST_CASE("Escaped characters") {
+    uint64_t prev_escaped = 0;
+    // Backslashes at 0, 1, 2 and 5: the characters at 3 and 6 are escaped.
+    CHECK(fastgrep::json::find_escaped(0x27, prev_escaped) == 0x4a);
+    CHECK(prev_escaped == 0);
+
+    // An odd backslash sequence at the end of a block escapes the first character of the next one.
+    fastgrep::json::find_escaped(1ULL << 63, prev_escaped);
+    CHECK(prev_escaped == 1);
+    CHECK(fastgrep::json::find_escaped(0, prev_escaped) == 1);
+    CHECK(fastgrep::json::prefix_xor(0x11) == 0x0f);
+}
+
+TEST_CASE("FieldConstraints should check the top-level fields of JSON objects") {
+    SECTION("Invalid constraints") {
+        fastgrep::FieldConstraints fields;
+        CHECK(fields.empty());
+        CHECK_THROWS(fields.add("LEVEL"));
+        CHECK_THROWS(fields.add("=error"));
+    }
+
+    SECTION("String and other values") {
+        auto fields = create({"LEVEL=error", "id=42"});
+        CHECK(is_matched(fields, "header {\"LEVEL\":\"error\",\"id\":42}"));
+        CHECK(is_matched(fields, "{ \"id\" : 42 , \"LEVEL\" : \"error\" }"));
+        CHECK(is_matched(fields, "{\"LEVEL\":\"error\",\"id\":\"42\"}"));
+        CHECK_FALSE(is_matched(fields, "{\"LEVEL\":\"error\",\"id\":420}"));
+        CHECK_FALSE(is_matched(fields, "{\"LEVEL\":\"error\"}"));
+        CHECK_FALSE(is_matched(fields, "No JSON object: LEVEL=error id=42"));
+    }
+
+    SECTION("Nested objects and arrays are skipped") {
+        auto fields = create({"LEVEL=error"});
+        CHECK_FALSE(is_matched(fields, "{\"data\":{\"LEVEL\":\"error\"},\"LEVEL\":\"info\"}"));
+        CHECK_FALSE(is_matched(fields, "{\"data\":[\"LEVEL\",\"error\"]}"));
+        CHECK_FALSE(is_matched(fields, "{\"data\":\"LEVEL\",\"x\":\"error\"}"));
+        CHECK(is_matched(fields,
+                         "{\"data\":{\"LEVEL\":\"info\",\"a\":[1,{\"b\":2}]},\"LEVEL\":\"error\"}"));
+    }
+
+    SECTION("Escaped quotes and backslashes across blocks") {
+        auto fields = create({"LEVEL=error"});
+        for (size_t len = 0; len < 2 * fastgrep::json::BLOCK_SIZE; ++len) {
+            const std::string padding(len, 'x');
+            CHECK(is_matched(fields, "{\"msg\":\"" + padding + "\\\"\",\"LEVEL\":\"error\"}"));
+            CHECK(is_matched(fields, "{\"msg\":\"" + padding + "\\\\\",\"LEVEL\":\"error\"}"));
+            CHECK_FALSE(is_matched(fields, "{\"msg\":\"" + padding + "\\\",\\\"LEVEL\\\":\\\"error\"}"));
+            CHECK_FALSE(
+                is_matched(fields, "{\"msg\":\"" + padding + "\\\\\\\",\\\"LEVEL\\\":\\\"error\"}"));
+        }
+    }
+
+    SECTION("Values of the same key are alternatives") {
+        auto fields = create({"LEVEL=error", "LEVEL=warning", "pool=db"});
+        CHECK(is_matched(fields, "{\"LEVEL\":\"error\",\"pool\":\"db\"}"));
+        CHECK(is_matched(fields, "{\"LEVEL\":\"warning\",\"pool\":\"db\"}"));
+        CHECK_FALSE(is_matched(fields, "{\"LEVEL\":\"info\",\"pool\":\"db\"}"));
+        CHECK_FALSE(is_matched(fields, "{\"LEVEL\":\"error\",\"pool\":\"web\"}"));
+    }
+
+    SECTION("Filter runs of lines") {
+        auto fields = create({"LEVEL=error"});
+        const std::vector<std::string> lines = {
+            "06-12-2018 10:00:00 job1070 db.db7.urgent {\"LEVEL\":\"error\"}",
+            "06-12-2018 10:00:01 job1070 db.db7.urgent {\"LEVEL\":\"error\",\"id\":1}",
+            "  A continuation line with \"LEVEL\":\"error\"",
+            "06-12-2018 10:00:02 job1070 db.db7.urgent {\"LEVEL\":\"info\",\"msg\":\"error\"}",
+            "06-12-2018 10:00:03 job1070 db.db7.urgent {\"LEVEL\":\"error\"}",
+        };
+        std::string data;
+        for (auto const &line : lines) data.append(line + "\n");
+        const std::vector<std::string> expected = {lines[0], lines[1], lines[4]};
+        CHECK(filter(fields, data) == expected);
+    }
+}
@@ -0,0 +1,100 @@
+#include "fmt/format.h"
+#include <random>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "header_filter.hpp"
+#include "timestamp.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    // Pass nlines lines to the filter in each call so messages span several calls.
+    std::vector<std::string> filter(fastgrep::HeaderConstraints &header,
+                                    const std::vector<std::string> &lines, const size_t nlines) {
+        std::vector<std::string> results;
+        auto process = [&results](const char *run, const size_t len) {
+            const char *start = run;
+            const char *last = run + len;
+            while (start < last) {
+                const char *eol = static_cast<const char *>(memchr(start, fastgrep::EOL, last - start));
+                results.emplace_back(start, eol - start);
+                start = eol + 1;
+            }
+        };
+
+        header.reset();
+        for (size_t idx = 0; idx < lines.size(); idx += nlines) {
+            std::string data;
+            for (size_t pos = idx; pos < std::min(idx + nlines, lines.size()); ++pos) {
+                data.append(lines[pos] + "\n");
+            }
+            header.filter(data.data(), data.data() + data.size(), process);
+        }
+        return results;
+    }
+} // namespace
+
+TEST_CASE("SIMD timestamp parser should produce the same results as the scalar parser") {
+    std::mt19937 engine(2018);
+    const std::string alphabet = "0123456789-/: T";
+    std::uniform_int_distribution<size_t> dist(0, alphabet.size() - 1);
+    std::uniform_int_distribution<int> pos_dist(0, 18);
+    for (size_t count = 0; count < 20000; ++count) {
+        std::string line = fmt::format("{:02}-{:02}-{:04} {:02}:{:02}:{:02} node pool", count % 14,
+                                       count % 33, 1970 + count % 100, count % 25, count % 61, count % 62);
+        if (count % 3 == 0) line[pos_dist(engine)] = alphabet[dist(engine)];
+        int64_t expected = 0, value = 0;
+        const char *end = line.data() + line.size();
+        const bool is_valid = fastgrep::timestamp::parse_scalar(line.data(), end, expected);
+        CHECK(fastgrep::timestamp::parse(line.data(), end, value) == is_valid);
+        if (is_valid) CHECK(value == expected);
+    }
+}
+
+TEST_CASE("HeaderConstraints should keep the messages whose headers are accepted") {
+    const std::vector<std::string> lines = {
+        "Lines before the first header are rejected",
+        "06-12-2018 10:00:00 job1070.athenahealth.com db.db7.urgent {\"LEVEL\":\"error\"}",
+        "  A continuation line",
+        "06-12-2018 10:00:01 job1071.athenahealth.com db.db7.normal {\"LEVEL\":\"info\"}",
+        "06-12-2018 10:00:02 job1070.athenahealth.com db.db8.urgent {\"LEVEL\":\"info\"}",
+        "  Another continuation line",
+        "06-12-2018 10:00:03 job1070.athenahealth.com db.db7.normal",
+        "06-12-2018 10:00:04 job1070.athenahealth.com",
+        "06-12-2018 10:00:05 job1070",
+    };
+
+    SECTION("Empty constraints") {
+        fastgrep::HeaderConstraints header;
+        CHECK(header.empty());
+    }
+
+    SECTION("Node and pool constraints") {
+        fastgrep::HeaderConstraints header;
+        header.add_node("job1070.athenahealth.com");
+        header.add_pool("db.db7.*");
+        CHECK_FALSE(header.empty());
+        const std::vector<std::string> expected = {lines[1], lines[2], lines[6]};
+        for (size_t nlines : {1, 2, 3, 100}) CHECK(filter(header, lines, nlines) == expected);
+    }
+
+    SECTION("Time and node constraints") {
+        fastgrep::HeaderConstraints header;
+        const int64_t start = fastgrep::timestamp::parse("06-12-2018 10:00:00");
+        header.set_time_range(start + 1, start + 4);
+        header.add_node("job1070*");
+        const std::vector<std::string> expected = {lines[4], lines[5], lines[6], lines[7]};
+        CHECK(filter(header, lines, 2) == expected);
+    }
+
+    SECTION("Fields which do not exist are rejected") {
+        fastgrep::HeaderConstraints header;
+        header.add_pool("*");
+        const std::vector<std::string> expected = {lines[1], lines[2], lines[3],
+                                                   lines[4], lines[5], lines[6]};
+        CHECK(filter(header, lines, 2) == expected);
+    }
+}
@@ -0,0 +1,66 @@
+#include "fmt/format.h"
+#include <string>
+
+#include "constants.hpp"
+#include "inverse_policy.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "scanners.hpp"
+#include "stream.hpp"
+#include "test_policies.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    std::string generate_data() {
+        std::string data;
+        for (int idx = 0; idx < 1000; ++idx) {
+            data.append(fmt::format("{} This is a heartbeat line.", idx));
+            if (idx % 7 == 0) data.append(" It has a needle in it.");
+            data.push_back(fastgrep::EOL);
+        }
+        data.append("The last line has a needle but it does not have EOL");
+        return data;
+    }
+
+    template <typename Policy>
+    std::string grep(const std::string &patt, const std::string &data, const size_t chunk_size, const int info,
+                     const char *fname = nullptr, const size_t max_count = 0) {
+        fastgrep::Params params;
+        params.info = info;
+        params.max_count = max_count;
+        return fastgrep::test::search_chunks<Policy>(patt, params, data, chunk_size, fname).buffer;
+    }
+} // namespace
+
+TEST_CASE("InversePolicy should produce the same results as StreamPolicy") {
+    using Scanner = fastgrep::hyperscan::Scanner;
+    using Expected = fastgrep::StreamPolicy<fastgrep::ScanMatcherInv<Scanner>, fastgrep::StringPolicy>;
+    using Policy = fastgrep::InversePolicy<Scanner, fastgrep::StringPolicy>;
+    const std::string data = generate_data();
+    const std::vector<std::string> patterns = {"heartbeat", "needle", "^1.*line\\.$", "haystack"};
+
+    for (auto const &patt : patterns) {
+        for (auto chunk_size : {7, 64, 1000, 1 << 16}) {
+            CHECK(grep<Expected>(patt, data, chunk_size, 0) == grep<Policy>(patt, data, chunk_size, 0));
+            CHECK(grep<Expected>(patt, data, chunk_size, fastgrep::LINENUM) ==
+                  grep<Policy>(patt, data, chunk_size, fastgrep::LINENUM));
+            CHECK(grep<Expected>(patt, data, chunk_size, 0, "file.log") ==
+                  grep<Policy>(patt, data, chunk_size, 0, "file.log"));
+            CHECK(grep<Expected>(patt, data, chunk_size, fastgrep::LINENUM, "file.log") ==
+                  grep<Policy>(patt, data, chunk_size, fastgrep::LINENUM, "file.log"));
+            CHECK(grep<Expected>(patt, data, chunk_size, fastgrep::LINENUM, nullptr, 10) ==
+                  grep<Policy>(patt, data, chunk_size, fastgrep::LINENUM, nullptr, 10));
+        }
+    }
+}
+
+TEST_CASE("InversePolicy with an exact scanner") {
+    using Policy = fastgrep::InversePolicy<fastgrep::ExactScanner, fastgrep::StringPolicy>;
+    const std::string data = "a needle\nhay\nneedle\n\nhay hay\nneedle";
+    CHECK(grep<Policy>("needle", data, 3, 0) == "hay\n\nhay hay\n");
+    CHECK(grep<Policy>("needle", data, 3, fastgrep::LINENUM) == "2:hay\n4:\n5:hay hay\n");
+    CHECK(grep<Policy>("needle", data, 3, fastgrep::LINENUM, "a.log") ==
+          "a.log:2:hay\na.log:4:\na.log:5:hay hay\n");
+}
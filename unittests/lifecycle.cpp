@@ -0,0 +1,102 @@
+#include "fmt/format.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lifecycle.hpp"
+#include "timestamp.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    fastgrep::lifecycle::MessageId create_id(const std::string &text) {
+        fastgrep::lifecycle::MessageId id;
+        REQUIRE(id.assign(text.data(), text.size()));
+        return id;
+    }
+
+    std::string message(const int64_t value, const std::string &payload) {
+        return fastgrep::timestamp::format(value) + " job1070 db.db7.urgent " + payload + "\n";
+    }
+} // namespace
+
+TEST_CASE("Format timestamps") {
+    for (const std::string timestr : {"01-01-1970 00:00:00", "02-29-2000 23:59:59", "06-12-2018 10:05:07",
+                                      "12-31-1969 12:00:00"}) {
+        CHECK(fastgrep::timestamp::format(fastgrep::timestamp::parse(timestr)) == timestr);
+    }
+}
+
+TEST_CASE("FlatTable should behave like a hash map") {
+    fastgrep::lifecycle::FlatTable<size_t> table(4);
+    std::unordered_map<std::string, size_t> expected;
+    for (size_t idx = 0; idx < 100000; ++idx) {
+        const std::string key = fmt::format("{:020}", (idx * 7919) % 30011);
+        table[create_id(key)] += idx;
+        expected[key] += idx;
+    }
+    CHECK(table.size() == expected.size());
+    CHECK(4 * table.size() <= 3 * table.capacity());
+    for (auto const &item : expected) {
+        const size_t *value = table.find(create_id(item.first));
+        REQUIRE(value != nullptr);
+        CHECK(*value == item.second);
+    }
+    CHECK(table.find(create_id("unknown")) == nullptr);
+
+    size_t count = 0;
+    table.for_each([&count](const fastgrep::lifecycle::MessageId &, const size_t) { ++count; });
+    CHECK(count == expected.size());
+
+    fastgrep::lifecycle::MessageId id;
+    CHECK_FALSE(id.assign("", 0));
+    CHECK_FALSE(id.assign("123456789012345678901", 21));
+}
+
+TEST_CASE("Classify events") {
+    using namespace fastgrep::lifecycle;
+    auto classify_event = [](const std::string &subject, const std::string &level) {
+        return classify(subject.data(), subject.size(), level.data(), level.size());
+    };
+    CHECK(classify_event("publish", "info") == PUBLISH);
+    CHECK(classify_event("publish", "error") == ERROR);
+    CHECK(classify_event("publisherror", "info") == ERROR);
+    CHECK(classify_event("ack", "info") == CONTROL);
+    CHECK(classify_event("", "") == CONTROL);
+}
+
+TEST_CASE("LifecycleTracker should report latencies and stuck messages") {
+    const int64_t start = fastgrep::timestamp::parse("06-12-2018 10:00:00");
+    std::string data = "A line before the first message\n";
+    data += message(start, R"({"ID":"msg1","SUBJECT":"publish","LEVEL":"info"})");
+    data += message(start + 1, R"({"SUBJECT":"publish","ID":"msg2"})");
+    data += "  A continuation line {\"ID\":\"msg3\",\"SUBJECT\":\"publish\"}\n";
+    data += message(start + 2, R"({"ID":"msg3","SUBJECT":"publish","data":{"ID":"msg9"}})");
+    data += message(start + 5, R"({"ID":"msg1","SUBJECT":"ack"})");
+    data += message(start + 6, R"({"ID":"msg2","SUBJECT":"publisherror","LEVEL":"error"})");
+    data += message(start + 9, R"({"ID":"msg1","SUBJECT":"done"})");
+    data += message(start + 10, R"({"ID":"12345678901234567890123","SUBJECT":"publish"})");
+    data += message(start + 10, R"({"SUBJECT":"publish"})");
+    data += message(start + 400, R"({"ID":"msg3","SUBJECT":"ack"})");
+    data += message(start + 500, R"({"ID":"msg4","SUBJECT":"publish"})");
+
+    fastgrep::LifecycleTracker tracker;
+    tracker.process(data.data(), data.size());
+    CHECK(tracker.number_of_messages() == 4);
+
+    const fastgrep::lifecycle::Record *record = tracker.find(create_id("msg1"));
+    REQUIRE(record != nullptr);
+    CHECK(record->publish_time == start);
+    CHECK(record->control_time == start + 9);
+    CHECK(record->counts[fastgrep::lifecycle::CONTROL] == 2);
+    CHECK(tracker.find(create_id("msg9")) == nullptr);
+
+    CHECK(tracker.latencies() == std::vector<int64_t>{9, 398});
+
+    // msg2 only has an error and msg4 is published less than stuck_after seconds before the end.
+    const auto stuck = tracker.stuck_messages();
+    REQUIRE(stuck.size() == 1);
+    CHECK(stuck.front().first.to_string() == "msg2");
+    CHECK(stuck.front().second.last_type == fastgrep::lifecycle::ERROR);
+}
@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "constants.hpp"
+#include "line_index.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+TEST_CASE("LineIndex should give the same results as memchr, memrchr, and std::count") {
+    std::mt19937 engine(2018);
+    std::uniform_int_distribution<int> dist(0, 9);
+    std::string data(1000, 'a');
+    for (auto &c : data) c = (dist(engine) == 0) ? fastgrep::EOL : 'a';
+
+    const char *begin = data.data();
+    fastgrep::LineIndex index;
+    for (const size_t len : {0, 1, 63, 64, 65, 128, 999, 1000}) {
+        const char *last = begin + len;
+        index.build(begin, last);
+        for (const char *ptr = begin; ptr <= last; ++ptr) {
+            CHECK(index.next(ptr) == memchr(ptr, fastgrep::EOL, last - ptr));
+            CHECK(index.prev(ptr) == memrchr(begin, fastgrep::EOL, ptr - begin));
+            CHECK(index.count(begin, ptr) == static_cast<size_t>(std::count(begin, ptr, fastgrep::EOL)));
+            CHECK(index.count(ptr, last) == static_cast<size_t>(std::count(ptr, last, fastgrep::EOL)));
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include <string>
+#include <vector>
+
+#include "literals.hpp"
+#include "scanners.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    using Literals = fastgrep::literals::Literals;
+    Literals extract(const std::string &pattern, const int mode = HS_FLAG_DOTALL) {
+        return fastgrep::literals::required_literals(pattern, mode);
+    }
+} // namespace
+
+TEST_CASE("Extract required literals from regular expressions") {
+    CHECK(extract("p4pqmewebsync.*finished in (\\d)*") == Literals{"p4pqmewebsync"});
+    CHECK(extract("Twain") == Literals{"Twain"});
+    CHECK(extract("abc*defg") == Literals{"defg"});
+    CHECK(extract("abcd+") == Literals{"abcd"});
+    CHECK(extract("foo\\.bar") == Literals{"foo.bar"});
+    CHECK(extract("\\x41BC\\x{44}") == Literals{"ABCD"});
+    CHECK(extract("[]abc]+defg") == Literals{"defg"});
+    CHECK(extract("[a-z]shing") == Literals{"shing"});
+    CHECK(extract("(?:error|warning): disk") == Literals{": disk"});
+    CHECK(extract("(?:error|warning)\\d+") == Literals{"error", "warning"});
+    CHECK(extract("Tom|Sawyer|Huckleberry|Finn") == Literals{"Finn", "Huckleberry", "Sawyer", "Tom"});
+
+    SECTION("Patterns without useful literals") {
+        CHECK(extract("a.*b").empty());
+        CHECK(extract("error|w").empty());
+        CHECK(extract("(error)?\\d+").empty());
+        CHECK(extract("\\bfoo\\1").empty());
+        CHECK(extract("(?i)Twain").empty());
+        CHECK(extract("(?=foo)foo").empty());
+        CHECK(extract("Twain", HS_FLAG_DOTALL | HS_FLAG_CASELESS).empty());
+    }
+}
+
+TEST_CASE("Prefilter should return the end of the first literal") {
+    const std::string data = "xyz abc\nabc\nxyz\n";
+    const char *begin = data.data();
+    const char *end = begin + data.size();
+    fastgrep::literals::Prefilter prefilter(Literals{"abc", "xyz"});
+    CHECK(prefilter.find(begin, end) == begin + 3);
+    CHECK(prefilter.find(begin + 3, end) == begin + 7);
+    CHECK(prefilter.find(begin + 8, end) == begin + 11);
+    CHECK(prefilter.find(begin + 12, end) == begin + 15);
+    CHECK(prefilter.find(begin + 16, end) == nullptr);
+}
+
+TEST_CASE("Scanner should find the same lines with and without the prefilter") {
+    std::string data;
+    for (size_t idx = 0; idx < 1000; ++idx) {
+        data.append(std::to_string(idx));
+        data.append((idx % 7 == 0) ? " p4pqmewebsync finished in 12 ms\n" : " p4pqmewebsync started\n");
+    }
+
+    auto find_lines = [&data](auto &scanner) {
+        std::vector<std::string> lines;
+        const char *start = data.data();
+        const char *end = start + data.size();
+        const char *match_end;
+        while ((start < end) && (match_end = scanner.find(start, end))) {
+            const char *last_char = match_end - 1;
+            const char *line_begin = static_cast<const char *>(memrchr(start, '\n', last_char - start));
+            line_begin = (line_begin == nullptr) ? start : line_begin + 1;
+            const char *line_end = static_cast<const char *>(memchr(last_char, '\n', end - last_char));
+            if (scanner.verify(line_begin, line_end - line_begin + 1)) {
+                lines.emplace_back(line_begin, line_end);
+            }
+            start = line_end + 1;
+        }
+        return lines;
+    };
+
+    const std::string pattern = "p4pqmewebsync.*finished in (\\d)*";
+    const int mode = HS_FLAG_DOTALL | HS_FLAG_SINGLEMATCH;
+    fastgrep::hyperscan::Scanner scanner(pattern, mode);
+    fastgrep::hyperscan::MultiScanner multi_scanner(pattern, mode);
+    const auto lines = find_lines(scanner);
+    CHECK(lines.size() == 143);
+    CHECK(lines == find_lines(multi_scanner));
+}
@@ -0,0 +1,104 @@
+#include "fmt/format.h"
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "header_filter.hpp"
+#include "message_pipeline.hpp"
+#include "reader.hpp"
+#include "temp_files.hpp"
+#include "timestamp.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    // Collect all lines given to the policy. Each chunk must start at a message boundary.
+    class CollectPolicy {
+      public:
+        struct Console {
+            std::string buffer;
+        };
+
+        void process(const char *begin, const size_t len) {
+            console.buffer.append(begin, len);
+            ++nruns;
+        }
+        bool is_done() const { return false; }
+        Console &get_console() { return console; }
+        size_t number_of_matches() const { return nruns; }
+
+      protected:
+        void set_filename(const char *) {}
+        void finalize() {}
+
+      private:
+        Console console;
+        size_t nruns = 0;
+    };
+
+    // Messages of two nodes with continuation lines which are longer than the chunk size.
+    std::string generate_messages() {
+        std::string content = "A line before the first message\n";
+        for (int idx = 0; idx < 2000; ++idx) {
+            content.append(fmt::format("06-12-2018 10:{:02}:{:02} job{} db.db{}.urgent Message {}\n",
+                                       idx / 60 % 60, idx % 60, 1070 + idx % 2, idx % 3, idx));
+            if (idx % 7 == 0) content.append(std::string(idx % 300, 'x') + "\n");
+        }
+        content.append("06-12-2018 11:00:00 job1070 db.db0.urgent The last line does not have EOL");
+        return content;
+    }
+} // namespace
+
+TEST_CASE("Message boundaries") {
+    const std::string data = "06-12-2018 10:00:00 foo\n  bar\n06-12-2018 10:00:01 foo\n  ba";
+    const char *begin = data.data();
+    const char *end = begin + data.size();
+    CHECK(fastgrep::pipeline::last_message(begin, end) == begin + 30);
+    CHECK(fastgrep::pipeline::last_message(begin, begin + 30) == nullptr);
+    CHECK(fastgrep::pipeline::last_line(begin, end) == begin + 54);
+    CHECK(fastgrep::pipeline::last_line(end - 4, end) == nullptr);
+}
+
+TEST_CASE("MessagePipeline should produce the same results as FileReader") {
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_messages());
+    fastgrep::HeaderConstraints header;
+    header.add_node("job1070");
+    header.add_pool("db.db1.*");
+
+    fastgrep::FileReader<CollectPolicy> reader;
+    reader.set_header_constraints(header);
+    reader(fname.data());
+    const std::string expected = reader.get_console().buffer;
+    REQUIRE(!expected.empty());
+
+    using Worker = fastgrep::ChunkSearch<CollectPolicy>;
+    auto setup = [&header](Worker &worker) { worker.set_header_constraints(header); };
+    for (const size_t nthreads : {1, 3}) {
+        for (const size_t chunk_size : {1, 64, 1000, 1 << 20}) {
+            std::string results;
+            auto sink = [&results](const std::string &data) { results.append(data); };
+            fastgrep::MessagePipeline<Worker> pipeline(nthreads, true, chunk_size);
+            CHECK(pipeline(fname.data(), setup, sink) > 0);
+            CHECK(results == expected);
+        }
+    }
+
+    SECTION("Chunks which end at EOL") {
+        fastgrep::MessagePipeline<Worker> pipeline(2, false, 100);
+        std::string results;
+        auto sink = [&results](const std::string &data) { results.append(data); };
+        auto no_setup = [](Worker &) {};
+        pipeline(fname.data(), no_setup, sink);
+        CHECK(results == generate_messages() + "\n");
+    }
+}
+
+TEST_CASE("MessagePipeline should report read errors") {
+    using Worker = fastgrep::ChunkSearch<CollectPolicy>;
+    fastgrep::MessagePipeline<Worker> pipeline(2);
+    auto no_setup = [](Worker &) {};
+    auto sink = [](const std::string &) {};
+    CHECK_THROWS(pipeline("/tmp", no_setup, sink));
+}
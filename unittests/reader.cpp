@@ -0,0 +1,95 @@
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "constants.hpp"
+#include "reader.hpp"
+#include "temp_files.hpp"
+#include "test_policies.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    using fastgrep::test::LinePolicy;
+
+    std::string generate_content(std::vector<std::string> &expected) {
+        std::string content;
+        for (size_t idx = 0; idx < 5000; ++idx) {
+            // Some lines are much longer than the read buffer.
+            const size_t len = (idx % 1000 == 999) ? 100000 : (idx % 97);
+            expected.emplace_back(std::string(len, 'a' + idx % 26));
+            content.append(expected.back());
+            content.push_back(fastgrep::EOL);
+        }
+
+        // The last line does not have EOL.
+        expected.emplace_back("The last line");
+        content.append(expected.back());
+        return content;
+    }
+} // namespace
+
+TEST_CASE("FileReader should only pass complete lines to its policy") {
+    std::vector<std::string> expected;
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_content(expected));
+    fastgrep::FileReader<LinePolicy> reader;
+    reader.set_buffer_size(1 << 12);
+    reader(fname.data());
+    CHECK(reader.calls > 1);
+    CHECK(reader.is_valid);
+    CHECK(reader.lines == expected);
+}
+
+TEST_CASE("All I/O methods should produce the same lines") {
+    std::vector<std::string> expected;
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_content(expected));
+    for (auto method : {fastgrep::IOMethod::READ, fastgrep::IOMethod::MMAP, fastgrep::IOMethod::DIRECT,
+                         fastgrep::IOMethod::READ_AHEAD}) {
+        fastgrep::FileReader<LinePolicy> reader;
+        reader.set_buffer_size(1 << 12);
+        reader.set_io_method(method);
+        reader(fname.data());
+        CHECK(reader.is_valid);
+        CHECK(reader.lines == expected);
+    }
+}
+
+TEST_CASE("The I/O strategy selector") {
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+
+    SECTION("Pipes and empty files are read using the given buffer size") {
+        info.st_mode = S_IFIFO;
+        CHECK(fastgrep::select_io_strategy(-1, info, 1 << 16).method == fastgrep::IOMethod::READ);
+        info.st_mode = S_IFREG;
+        CHECK(fastgrep::select_io_strategy(-1, info, 1 << 16).buffer_size == (1 << 16));
+    }
+
+    SECTION("Small files are read using a single read call") {
+        info.st_mode = S_IFREG;
+        info.st_size = 100;
+        auto strategy = fastgrep::select_io_strategy(-1, info, 1 << 16);
+        CHECK(strategy.method == fastgrep::IOMethod::READ);
+        CHECK(strategy.buffer_size == 101);
+    }
+
+    SECTION("A file which is in the page cache is memory mapped") {
+        std::string content;
+        for (size_t idx = 0; idx < 100000; ++idx) content.append("This line is repeated many times\n");
+        fastgrep::test::TempFiles files;
+        const std::string fname = files.write(content);
+        int fd = open(fname.data(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        REQUIRE(fstat(fd, &info) == 0);
+        std::vector<char> buffer(info.st_size);
+        REQUIRE(read(fd, buffer.data(), buffer.size()) == info.st_size);
+        CHECK(fastgrep::select_io_strategy(fd, info, 1 << 16).method == fastgrep::IOMethod::MMAP);
+        close(fd);
+    }
+}
@@ -0,0 +1,107 @@
+#include "fmt/format.h"
+#include <string>
+
+#include "constants.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "scan_policy.hpp"
+#include "scanners.hpp"
+#include "stream.hpp"
+#include "test_policies.hpp"
+#include "utils/regex_matchers.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    using fastgrep::test::TestPolicy;
+
+    std::string generate_data() {
+        std::string data;
+        for (int idx = 0; idx < 1000; ++idx) {
+            data.append(fmt::format("{} This is line number {}.", idx, idx));
+            if (idx % 7 == 0) data.append(" It has a needle in it.");
+            data.push_back(fastgrep::EOL);
+        }
+        data.append("The last line has a needle but it does not have EOL");
+        return data;
+    }
+
+    template <typename Policy> fastgrep::StorePolicy grep(const std::string &patt, const std::string &data,
+                                                          const size_t chunk_size, const bool linenum) {
+        fastgrep::Params params;
+        params.info = linenum * fastgrep::LINENUM;
+        return fastgrep::test::search_chunks<Policy>(patt, params, data, chunk_size);
+    }
+} // namespace
+
+TEST_CASE("ScanPolicy should produce the same results as StreamPolicy") {
+    using Matcher = utils::hyperscan::RegexMatcher;
+    using Scanner = fastgrep::hyperscan::Scanner;
+    using Expected = fastgrep::StreamPolicy<Matcher, fastgrep::StorePolicy>;
+    using Policy = fastgrep::ScanPolicy<Scanner, fastgrep::StorePolicy>;
+    const std::string data = generate_data();
+    const std::vector<std::string> patterns = {"needle", "^1.*needle", "line\\.$", "number 99", "haystack"};
+
+    for (auto const &patt : patterns) {
+        for (auto chunk_size : {7, 64, 1000, 1 << 16}) {
+            auto expected = grep<Expected>(patt, data, chunk_size, true);
+            auto results = grep<Policy>(patt, data, chunk_size, true);
+            CHECK(expected.lines == results.lines);
+            CHECK(expected.linenums == results.linenums);
+        }
+    }
+}
+
+TEST_CASE("ScanPolicy with an exact scanner") {
+    using Policy = fastgrep::ScanPolicy<fastgrep::ExactScanner, fastgrep::StorePolicy>;
+    const std::string data = generate_data();
+    auto results = grep<Policy>("needle", data, 64, true);
+    REQUIRE(results.lines.size() == 144);
+    CHECK(results.linenums.front() == 1);
+    CHECK(results.lines.back() == "The last line has a needle but it does not have EOL");
+    CHECK(results.linenums.back() == 1001);
+}
+
+TEST_CASE("ScanPolicy should stop after max_count matched lines") {
+    using Policy = TestPolicy<fastgrep::ScanPolicy<fastgrep::ExactScanner, fastgrep::StorePolicy>>;
+    const std::string data = generate_data();
+    fastgrep::Params params;
+    params.info = fastgrep::LINENUM;
+    params.max_count = 3;
+    Policy pol("needle", params);
+    fastgrep::test::process_chunks(pol, data, 64);
+    CHECK(pol.is_done());
+    CHECK(pol.number_of_matches() == 3);
+    CHECK(pol.console.linenums == std::vector<size_t>{1, 8, 15});
+}
+
+TEST_CASE("ScanPolicy with a multi-pattern scanner") {
+    using Policy = fastgrep::ScanPolicy<fastgrep::hyperscan::MultiScanner, fastgrep::StorePolicy>;
+    const std::string data = generate_data();
+    for (auto chunk_size : {7, 64, 1 << 16}) {
+        auto results = grep<Policy>("number 99\nneedle\n^12 ", data, chunk_size, true);
+        REQUIRE(results.lines.size() == 155); // Line 994 matches two patterns.
+        CHECK(results.linenums[0] == 1);
+        CHECK(results.linenums[1] == 8);
+        CHECK(results.lines.back() == "The last line has a needle but it does not have EOL");
+    }
+
+    fastgrep::hyperscan::MultiScanner scanner("foo\nba+r", 0);
+    const std::string line = "xx baaar\n";
+    REQUIRE(scanner.verify(line.data(), line.size()));
+    CHECK(scanner.matched_pattern() == "ba+r");
+    CHECK(fastgrep::hyperscan::escape("a.b") == "a\\x2eb");
+}
+
+TEST_CASE("ScanPolicy should show the literal patterns given by users") {
+    using Scanner = fastgrep::hyperscan::ExactMultiScanner;
+    using Policy = TestPolicy<fastgrep::ScanPolicy<Scanner, fastgrep::StringPolicy>>;
+    fastgrep::Params params;
+    params.info = fastgrep::EXACT_MATCH | fastgrep::SHOW_PATTERN;
+    Policy pol("user-123\nuser.123\na+b", params);
+    const std::string data = "id user-123 ok\nid userx123\nid user.123\nid aab\nid a+b\n";
+    pol.process(data.data(), data.size());
+    pol.finalize();
+    CHECK(pol.console.buffer == "user-123:id user-123 ok\nuser.123:id user.123\na+b:id a+b\n");
+}
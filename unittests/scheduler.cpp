@@ -0,0 +1,149 @@
+#include "fmt/format.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ioutils/regex_store_policies.hpp"
+#include "ioutils/search.hpp"
+#include "queue.hpp"
+#include "scheduler.hpp"
+#include "search_policy.hpp"
+#include "temp_files.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+TEST_CASE("BoundedQueue") {
+    fastgrep::BoundedQueue<size_t> queue(5);
+    size_t value;
+    REQUIRE(!queue.try_pop(value));
+    for (size_t idx = 0; idx < 8; ++idx) { REQUIRE(queue.try_push(size_t(idx))); }
+    REQUIRE(!queue.try_push(8));
+    for (size_t idx = 0; idx < 8; ++idx) {
+        REQUIRE(queue.try_pop(value));
+        CHECK(value == idx);
+    }
+    queue.close();
+    REQUIRE(!queue.pop(value));
+}
+
+TEST_CASE("SPSCQueue should keep the order of items") {
+    constexpr size_t nitems = 100000;
+    fastgrep::SPSCQueue<size_t> queue(4);
+    std::thread producer([&queue]() {
+        for (size_t idx = 0; idx < nitems; ++idx) { queue.push(size_t(idx)); }
+        queue.close();
+    });
+    size_t value, count = 0;
+    while (queue.pop(value)) {
+        REQUIRE(value == count);
+        ++count;
+    }
+    producer.join();
+    CHECK(count == nitems);
+}
+
+TEST_CASE("Waiting threads should sleep until the queue is closed") {
+    fastgrep::BoundedQueue<size_t> queue(4);
+    fastgrep::Scheduler<size_t> scheduler(4, queue);
+    std::atomic<size_t> ntasks(0);
+    scheduler.start([&scheduler, &ntasks](const size_t worker) {
+        size_t task;
+        while (scheduler.next(worker, task)) ++ntasks;
+    });
+    std::vector<std::thread> consumers;
+    for (size_t idx = 0; idx < 4; ++idx) {
+        consumers.emplace_back([&queue]() {
+            size_t value;
+            while (queue.pop(value)) {}
+        });
+    }
+
+    // Idle workers and consumers do not spin so they use almost no CPU time.
+    const std::clock_t start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const double cpu_time = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+    CHECK(cpu_time < 0.1);
+
+    queue.close();
+    scheduler.join();
+    for (auto &consumer : consumers) consumer.join();
+    CHECK(ntasks == 0);
+}
+
+TEST_CASE("All tasks should be processed exactly once") {
+    constexpr size_t ntasks = 1000;
+    for (size_t nthreads : {1, 3, 8}) {
+        fastgrep::BoundedQueue<size_t> tasks(64);
+        fastgrep::Scheduler<size_t> scheduler(nthreads, tasks);
+        std::vector<std::atomic<int>> counters(ntasks);
+        for (auto &counter : counters) counter = 0;
+        scheduler.start([&scheduler, &counters](const size_t worker) {
+            size_t task;
+            while (scheduler.next(worker, task)) { ++counters[task]; }
+        });
+        for (size_t idx = 0; idx < ntasks; ++idx) tasks.push(size_t(idx));
+        tasks.close();
+        scheduler.join();
+        for (auto const &counter : counters) { REQUIRE(counter == 1); }
+    }
+}
+
+TEST_CASE("OrderedOutput should keep the order of tasks") {
+    constexpr size_t ntasks = 100;
+    fastgrep::BoundedQueue<size_t> tasks(16);
+    fastgrep::Scheduler<size_t> scheduler(4, tasks);
+    fastgrep::OrderedOutput output;
+    scheduler.start([&scheduler, &output](const size_t worker) {
+        size_t task;
+        while (scheduler.next(worker, task)) { output.set(task, fmt::format("{}\n", task)); }
+    });
+    std::thread producer([&tasks, &output]() {
+        for (size_t idx = 0; idx < ntasks; ++idx) tasks.push(size_t(idx));
+        tasks.close();
+        output.close(ntasks);
+    });
+    std::string results;
+    output.write([&results](const std::string &data) { results.append(data); });
+    producer.join();
+    scheduler.join();
+
+    std::string expected;
+    for (size_t idx = 0; idx < ntasks; ++idx) expected.append(fmt::format("{}\n", idx));
+    CHECK(results == expected);
+}
+
+TEST_CASE("The traversal should stop when consumers close the queue") {
+    constexpr size_t nfiles = 64;
+    fastgrep::test::TempFiles files;
+    const std::string dirname = files.directory();
+    for (size_t idx = 0; idx < nfiles; ++idx) {
+        const std::string fname = fmt::format("{}/{}.log", dirname, idx);
+        FILE *file = fopen(fname.data(), "w");
+        REQUIRE(file != nullptr);
+        files.add(fname);
+        fclose(file);
+    }
+
+    // This is what fgrep -q does after the first match.
+    fastgrep::PathQueue queue(2);
+    ioutils::search::Params params;
+    ioutils::FileSearch<fastgrep::QueueStorePolicy<ioutils::StorePolicy>> search(params);
+    search.set_queue(&queue);
+    size_t npushed = 0;
+    std::thread producer([&search, &queue, &npushed, &dirname]() {
+        npushed = fastgrep::traverse(search, std::vector<std::string>{dirname});
+        queue.close();
+    });
+    fastgrep::SearchTask task;
+    REQUIRE(queue.pop(task));
+    queue.close();
+    producer.join();
+    CHECK(npushed < nfiles);
+}
@@ -0,0 +1,112 @@
+#include "fmt/format.h"
+#include <string>
+#include <sys/stat.h>
+
+#include "constants.hpp"
+#include "output.hpp"
+#include "params.hpp"
+#include "reader.hpp"
+#include "scan_policy.hpp"
+#include "scanners.hpp"
+#include "sidecar.hpp"
+#include "temp_files.hpp"
+#include "timestamp.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    // Only a few blocks have a needle and the last line does not have EOL.
+    std::string generate_data() {
+        std::string data;
+        for (int idx = 0; idx < 1000; ++idx) {
+            data.append(fmt::format("06-{:02}-2018 10:{:02}:{:02} This is line number {}.", 1 + idx / 100,
+                                    idx % 60, idx % 60, idx));
+            if (idx % 250 == 3) data.append(" It has a needle in it.");
+            data.push_back(fastgrep::EOL);
+        }
+        data.append("The last line has a needle but it does not have EOL");
+        return data;
+    }
+
+    // Build and save the index of a file using small blocks.
+    void build_index(const std::string &fname) {
+        struct stat info;
+        REQUIRE(stat(fname.data(), &info) == 0);
+        fastgrep::FileReader<fastgrep::sidecar::Builder> builder(16);
+        builder(fname.data());
+        builder.save(fastgrep::sidecar::path(fname), info);
+    }
+
+    template <typename Reader> fastgrep::StorePolicy grep(Reader &reader, const std::string &fname) {
+        reader(fname.data());
+        return reader.get_console();
+    }
+} // namespace
+
+TEST_CASE("Parse timestamps") {
+    using fastgrep::timestamp::parse;
+    CHECK(parse("1970-01-01 00:00:00") == 0);
+    CHECK(parse("01-02-1970 00:00:01") == 86401);
+    CHECK(parse("06/21/2018 10:20:30") == parse("2018-06-21T10:20:30"));
+    CHECK(parse("03-01-2016 00:00:00") - parse("02-28-2016 00:00:00") == 2 * 86400);
+    CHECK_THROWS(parse("2018-13-01 00:00:00"));
+    CHECK_THROWS(parse("06-21-2018"));
+    CHECK_THROWS(parse("06-21-2018 10:20:3x"));
+}
+
+TEST_CASE("Build, save, and load a sidecar index") {
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_data());
+    const std::string index_file = fastgrep::sidecar::path(fname);
+    files.add(index_file);
+    build_index(fname);
+
+    struct stat info;
+    REQUIRE(stat(fname.data(), &info) == 0);
+    fastgrep::sidecar::Index index;
+    REQUIRE(index.load(index_file, info));
+    REQUIRE(index.size() == 63);
+    CHECK(index.number_of_lines() == 1001);
+    CHECK(index.block(1).line == 16);
+    CHECK(index.lines(62) == 9);
+    CHECK(index.end_offset(62) == static_cast<size_t>(info.st_size));
+
+    SECTION("A block may match if it has all trigrams of a literal") {
+        fastgrep::sidecar::Query query(fastgrep::literals::Literals{"needle"});
+        CHECK(query.may_match(index, 0));
+        CHECK(query.may_match(index, 62));
+        size_t nblocks = 0;
+        for (size_t idx = 0; idx < index.size(); ++idx) nblocks += query.may_match(index, idx);
+        CHECK(nblocks < 10);
+
+        // Short literals do not have any trigram.
+        CHECK(fastgrep::sidecar::Query(fastgrep::literals::Literals{"zz"}).may_match(index, 1));
+        CHECK(fastgrep::sidecar::Query().may_match(index, 1));
+    }
+
+    SECTION("An index of another version of the file is not used") {
+        info.st_size += 1;
+        CHECK_FALSE(index.load(index_file, info));
+    }
+}
+
+TEST_CASE("Indexed searches should produce the same results as normal searches") {
+    using Policy = fastgrep::ScanPolicy<fastgrep::ExactScanner, fastgrep::StorePolicy>;
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(generate_data());
+    files.add(fastgrep::sidecar::path(fname));
+    build_index(fname);
+
+    fastgrep::Params params;
+    params.info = fastgrep::LINENUM;
+    fastgrep::FileReader<Policy> expected_reader("needle", params);
+    auto expected = grep(expected_reader, fname);
+    REQUIRE(expected.lines.size() == 5);
+
+    fastgrep::FileReader<Policy> reader("needle", params);
+    reader.set_index_query(fastgrep::sidecar::Query(fastgrep::literals::Literals{"needle"}));
+    auto results = grep(reader, fname);
+    CHECK(results.lines == expected.lines);
+    CHECK(results.linenums == expected.linenums);
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simd.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    using fastgrep::simd::ISA;
+
+    // Use a small alphabet so we have many partial matches.
+    std::string random_string(const size_t len, std::mt19937 &engine) {
+        std::uniform_int_distribution<int> dist(0, 3);
+        std::string results(len, 'a');
+        for (auto &c : results) c = "ab\nc"[dist(engine)];
+        return results;
+    }
+} // namespace
+
+TEST_CASE("All supported SIMD kernels should give the same results as the scalar kernels") {
+    std::mt19937 engine(2018);
+    const auto expected = fastgrep::simd::make_kernels(ISA::SCALAR);
+    for (const ISA isa : {ISA::SSE2, ISA::AVX2, ISA::AVX512}) {
+        if (!fastgrep::simd::is_supported(isa)) continue;
+        const auto kernels = fastgrep::simd::make_kernels(isa);
+        CHECK(kernels.isa == isa);
+        const std::vector<std::string> needles{"ab", "abc", "ca\nb", "cabacabc", std::string(24, 'a')};
+        for (size_t len = 0; len < 300; ++len) {
+            const std::string data = random_string(len, engine);
+            const char *begin = data.data();
+            const char *end = begin + data.size();
+            CHECK(kernels.count(begin, end, '\n') == expected.count(begin, end, '\n'));
+            CHECK(kernels.find_char(begin, end, '\n') == expected.find_char(begin, end, '\n'));
+            CHECK(kernels.find_char(begin, end, 'x') == nullptr);
+            std::vector<uint64_t> bits((len + 63) / 64, ~0ULL), expected_bits(bits.size(), 0);
+            kernels.bitmap(begin, end, '\n', bits.data());
+            expected.bitmap(begin, end, '\n', expected_bits.data());
+            CHECK(bits == expected_bits);
+            if (!bits.empty()) {
+                const uint64_t first_mask = ~0ULL << (len % 64), last_mask = ~0ULL >> (len % 64);
+                CHECK(kernels.popcount(bits.data(), bits.size(), first_mask, last_mask) ==
+                      expected.popcount(bits.data(), bits.size(), first_mask, last_mask));
+            }
+            for (auto const &needle : needles) {
+                CHECK(kernels.find(begin, end, needle.data(), needle.size()) ==
+                      expected.find(begin, end, needle.data(), needle.size()));
+            }
+        }
+    }
+}
+
+TEST_CASE("The dispatched functions should handle short needles") {
+    const std::string data = "Hello world\n";
+    const char *begin = data.data();
+    const char *end = begin + data.size();
+    CHECK(fastgrep::simd::find(begin, end, "", 0) == begin);
+    CHECK(fastgrep::simd::find(begin, end, "w", 1) == begin + 6);
+    CHECK(fastgrep::simd::find(begin, end, "world", 5) == begin + 6);
+    CHECK(fastgrep::simd::find(begin, end, "worlds", 6) == nullptr);
+    CHECK(fastgrep::simd::find_char(begin, end, '\n') == end - 1);
+    CHECK(fastgrep::simd::count(begin, end, 'o') == 2);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace fastgrep {
+    namespace test {
+        // Temporary files of a test. All files are removed in the reverse order of their creation when this
+        // object is destroyed so they are also removed if a test fails in the middle.
+        class TempFiles {
+          public:
+            TempFiles() = default;
+            TempFiles(const TempFiles &) = delete;
+            TempFiles &operator=(const TempFiles &) = delete;
+
+            ~TempFiles() {
+                for (auto it = paths.rbegin(); it != paths.rend(); ++it) remove(it->data());
+            }
+
+            // Write the content to a new temporary file and return its path.
+            std::string write(const std::string &content) {
+                char fname[] = "/tmp/fastgrep_testXXXXXX";
+                const int fd = mkstemp(fname);
+                if (fd < 0) throw std::runtime_error("Cannot create a temporary file");
+                paths.emplace_back(fname);
+                const char *data = content.data();
+                size_t len = content.size();
+                while (len > 0) {
+                    const ssize_t nbytes = ::write(fd, data, len);
+                    if (nbytes <= 0) {
+                        close(fd);
+                        throw std::runtime_error(std::string("Cannot write to ") + fname);
+                    }
+                    data += nbytes;
+                    len -= nbytes;
+                }
+                close(fd);
+                return paths.back();
+            }
+
+            // Create a new temporary directory and return its path. Files added to it afterwards are
+            // removed before the directory.
+            std::string directory() {
+                char dirname[] = "/tmp/fastgrep_testXXXXXX";
+                if (mkdtemp(dirname) == nullptr) {
+                    throw std::runtime_error("Cannot create a temporary directory");
+                }
+                paths.emplace_back(dirname);
+                return paths.back();
+            }
+
+            // Remove the given file, e.g a file derived from a temporary file, together with ours.
+            void add(const std::string &path) { paths.push_back(path); }
+
+          private:
+            std::vector<std::string> paths;
+        };
+    } // namespace test
+} // namespace fastgrep
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "constants.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fastgrep {
+    namespace test {
+        // Expose the console and the protected methods of a policy so we can check the search results.
+        template <typename Policy> struct TestPolicy : public Policy {
+            template <typename Params>
+            TestPolicy(const std::string &patt, Params &&params) : Policy(patt, params) {}
+            using Policy::console;
+            using Policy::finalize;
+            using Policy::set_filename;
+        };
+
+        // Pass the data to a policy in chunks of chunk_size bytes, so lines cross chunk boundaries, until
+        // the policy is done like a reader does.
+        template <typename Policy>
+        void process_chunks(Policy &pol, const std::string &data, const size_t chunk_size) {
+            for (size_t pos = 0; (pos < data.size()) && !pol.is_done(); pos += chunk_size) {
+                pol.process(data.data() + pos, std::min(chunk_size, data.size() - pos));
+            }
+        }
+
+        // Search the data in chunks using a policy and return its console.
+        template <typename Policy, typename Params>
+        auto search_chunks(const std::string &patt, Params &&params, const std::string &data,
+                           const size_t chunk_size, const char *fname = nullptr) {
+            TestPolicy<Policy> pol(patt, params);
+            if (fname != nullptr) pol.set_filename(fname);
+            process_chunks(pol, data, chunk_size);
+            pol.finalize();
+            return pol.console;
+        }
+
+        // Record all lines passed to a policy by a reader. Readers must only pass complete lines.
+        class LinePolicy {
+          public:
+            void process(const char *begin, const size_t len) {
+                ++calls;
+                if ((len == 0) || (begin[len - 1] != EOL)) {
+                    is_valid = false;
+                    return;
+                }
+                const char *start = begin;
+                const char *end = begin + len;
+                while (start < end) {
+                    const char *ptr = static_cast<const char *>(memchr(start, EOL, end - start));
+                    lines.emplace_back(start, ptr - start);
+                    start = ptr + 1;
+                }
+            }
+
+            bool is_done() const { return false; }
+
+            std::vector<std::string> lines;
+            size_t calls = 0;
+            bool is_valid = true; // False if a reader passes an incomplete line.
+
+          protected:
+            void set_filename(const char *) { lines.clear(); }
+            void finalize() {}
+        };
+    } // namespace test
+} // namespace fastgrep
@@ -0,0 +1,93 @@
+#include "fmt/format.h"
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "constants.hpp"
+#include "reader.hpp"
+#include "temp_files.hpp"
+#include "test_policies.hpp"
+#include "time_range.hpp"
+#include "timestamp.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    using fastgrep::test::LinePolicy;
+
+    // A message is logged every two seconds, several messages share a timestamp, and some of them have
+    // continuation lines which are longer than the seeker window.
+    std::vector<std::string> generate_lines() {
+        std::vector<std::string> lines;
+        for (int idx = 0; idx < 3000; ++idx) {
+            const int seconds = 2 * (idx / 3);
+            lines.emplace_back(fmt::format("06-12-2018 10:{:02}:{:02} Message {}", seconds / 60 % 60,
+                                           seconds % 60, idx));
+            if (idx % 10 == 0) lines.emplace_back(std::string(idx % 7000, 'x'));
+        }
+        return lines;
+    }
+
+    // The lines of all messages whose timestamps are in [begin, end].
+    std::vector<std::string> expected_lines(const std::vector<std::string> &lines, const int64_t begin,
+                                            const int64_t end) {
+        std::vector<std::string> results;
+        bool is_selected = false;
+        for (auto const &line : lines) {
+            int64_t value;
+            if (fastgrep::timestamp::parse(line.data(), line.data() + line.size(), value)) {
+                is_selected = (value >= begin) && (value <= end);
+            }
+            if (is_selected) results.push_back(line);
+        }
+        return results;
+    }
+} // namespace
+
+TEST_CASE("TimeSeeker should find the same lines as a linear scan") {
+    const std::vector<std::string> lines = generate_lines();
+    std::string content;
+    for (auto const &line : lines) content.append(line + "\n");
+    fastgrep::test::TempFiles files;
+    const std::string fname = files.write(content);
+    const int64_t start = fastgrep::timestamp::parse("06-12-2018 10:00:00");
+
+    for (const int64_t first : {-10, 0, 1, 7, 500, 1998, 2100}) {
+        for (const int64_t last : {-1, 0, 5, 600, 1998, 5000}) {
+            fastgrep::FileReader<LinePolicy> reader;
+            reader.set_buffer_size(1 << 10);
+            reader.set_time_range(start + first, start + last);
+            reader(fname.data());
+            CHECK(reader.is_valid);
+            CHECK(reader.lines == expected_lines(lines, start + first, start + last));
+        }
+    }
+}
+
+TEST_CASE("TimeSeeker with corner cases") {
+    fastgrep::test::TempFiles files;
+    SECTION("A file without timestamps") {
+        const std::string fname = files.write("foo\nbar\n");
+        int fd = open(fname.data(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        fastgrep::TimeSeeker seeker(fd, 8);
+        CHECK(seeker.lower_bound(0) == 8);
+        close(fd);
+    }
+
+    SECTION("The last line does not have EOL") {
+        const std::string content = "06-12-2018 10:00:00 foo\n06-12-2018 10:00:01 bar";
+        const std::string fname = files.write(content);
+        int fd = open(fname.data(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        const int64_t start = fastgrep::timestamp::parse("06-12-2018 10:00:00");
+        auto range = fastgrep::find_time_range(fd, content.size(), start + 1, start + 1);
+        CHECK(range.begin == 24);
+        CHECK(range.end == content.size());
+        range = fastgrep::find_time_range(fd, content.size(), start + 2, start + 1);
+        CHECK(range.begin == range.end);
+        close(fd);
+    }
+}
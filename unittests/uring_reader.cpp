@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "fmt/format.h"
+#include "temp_files.hpp"
+#include "uring_reader.hpp"
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+namespace {
+    // Record the content of all searched files.
+    class FilePolicy {
+      public:
+        void process(const char *begin, const size_t len) {
+            REQUIRE(len > 0);
+            REQUIRE(begin[len - 1] == fastgrep::EOL);
+            content.append(begin, len);
+        }
+
+        bool is_done() const { return false; }
+        std::vector<std::string> files;
+        std::string content;
+
+      protected:
+        void set_filename(const char *fname) {
+            files.emplace_back(fname);
+            content.append(fname);
+            content.push_back(':');
+        }
+        void finalize() {}
+    };
+
+    struct Task {
+        size_t index = 0;
+        std::string path;
+    };
+
+    template <typename Reader>
+    void search(Reader &reader, const std::vector<std::string> &paths, std::vector<size_t> &done) {
+        size_t idx = 0;
+        auto next = [&paths, &idx](Task &task) {
+            if (idx == paths.size()) return false;
+            task.index = idx;
+            task.path = paths[idx++];
+            return true;
+        };
+        reader.template run<Task>(next, [&done](const Task &task) { done.push_back(task.index); });
+    }
+} // namespace
+
+TEST_CASE("UringReader should give the same results as FileReader") {
+    fastgrep::test::TempFiles files;
+    std::vector<std::string> paths;
+    for (size_t idx = 0; idx < 500; ++idx) {
+        std::string content;
+        for (size_t line = 0; line < idx % 13; ++line) content.append(fmt::format("{} {}\n", idx, line));
+
+        // Some files do not end with EOL and some files are bigger than a slot buffer.
+        if (idx % 7 == 0) content.append("The last line");
+        if (idx % 101 == 0) content.append(std::string(1 << 20, 'a'));
+
+        // Files around the size of a slot buffer.
+        const size_t slot_size = fastgrep::UringReader<FilePolicy>::MAX_SLOT_SIZE;
+        if (idx % 97 == 0) content = std::string(slot_size + idx % 3 - 1, 'b');
+        paths.push_back(files.write(content));
+    }
+    paths.push_back("/tmp/this_file_does_not_exist");
+
+    std::vector<size_t> done;
+    fastgrep::UringReader<FilePolicy> results;
+    search(results, paths, done);
+    CHECK(done.size() == paths.size());
+    CHECK(std::is_sorted(done.begin(), done.end()));
+
+    fastgrep::FileReader<FilePolicy> expected;
+    for (auto const &path : paths) expected(path.data());
+    CHECK(results.files == expected.files);
+    CHECK(results.content == expected.content);
+}
+
+TEST_CASE("UringReader should not search files after it is stopped") {
+    fastgrep::test::TempFiles files;
+    std::vector<std::string> paths;
+    for (size_t idx = 0; idx < 200; ++idx) paths.push_back(files.write(fmt::format("{}\n", idx)));
+    fastgrep::UringReader<FilePolicy> reader;
+    size_t idx = 0;
+    auto next = [&paths, &idx](Task &task) {
+        if (idx == paths.size()) return false;
+        task.index = idx;
+        task.path = paths[idx++];
+        return true;
+    };
+    std::vector<size_t> done;
+    auto stop = [&done]() { return done.size() == 3; };
+    reader.template run<Task>(next, [&done](const Task &task) { done.push_back(task.index); }, stop);
+    CHECK(done == std::vector<size_t>{0, 1, 2});
+    CHECK(reader.files.size() == 3);
+    CHECK(idx < paths.size());
+}